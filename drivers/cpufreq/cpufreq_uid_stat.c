@@ -0,0 +1,320 @@
+/*
+ *  drivers/cpufreq/cpufreq_uid_stat.c
+ *
+ *  CPU time of each uid in each CPU frequency.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The scheduler tick charges the time it accounts to a task to the uid
+ * of the task, in the frequency its CPU runs at, so that the time each
+ * uid spent at each frequency is known without walking every process.
+ *
+ * /proc/uid_time_in_state exports it in binary, as native endian u32s:
+ *
+ *	nr_freqs
+ *	freq[nr_freqs]			frequencies in kHz
+ *	followed, for each uid, by
+ *	uid
+ *	time[nr_freqs]			time at freq[i], in USER_HZ ticks
+ *
+ * The times wrap around, readers are expected to work with the deltas
+ * between two reads.  Uids are listed in the order they first ran, and
+ * are never removed.
+ *
+ * The frequencies are those of the first CPU with a frequency table;
+ * time spent at a frequency that is not in it is not accounted.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/proc_fs.h>
+#include <linux/fs.h>
+#include <linux/sched.h>
+#include <linux/cred.h>
+#include <asm/cputime.h>
+
+#define UID_HASH_BITS	6
+
+struct uid_entry {
+	struct hlist_node hash;
+	struct list_head link;
+	uid_t uid;
+	cputime64_t time_in_state[0];
+};
+
+/* Protects all of the below, taken from the scheduler tick. */
+static DEFINE_SPINLOCK(uid_stat_lock);
+static struct hlist_head uid_hash[1 << UID_HASH_BITS];
+static LIST_HEAD(uid_list);
+static unsigned int nr_uids;
+
+static unsigned int *uid_freqs;
+static unsigned int nr_uid_freqs;
+
+/* Index into uid_freqs of the current frequency of each CPU, or -1. */
+static DEFINE_PER_CPU(int, uid_freq_index) = -1;
+
+static int uid_freq_get_index(unsigned int freq)
+{
+	int index;
+
+	for (index = 0; index < nr_uid_freqs; index++)
+		if (uid_freqs[index] == freq)
+			return index;
+	return -1;
+}
+
+static struct uid_entry *find_or_create_uid_entry(uid_t uid)
+{
+	struct hlist_head *head = &uid_hash[hash_long(uid, UID_HASH_BITS)];
+	struct uid_entry *entry;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(entry, node, head, hash)
+		if (entry->uid == uid)
+			return entry;
+
+	entry = kzalloc(sizeof(*entry) + nr_uid_freqs * sizeof(cputime64_t),
+			GFP_ATOMIC);
+	if (!entry)
+		return NULL;
+	entry->uid = uid;
+	hlist_add_head(&entry->hash, head);
+	list_add_tail(&entry->link, &uid_list);
+	nr_uids++;
+	return entry;
+}
+
+/**
+ * cpufreq_account_uid_time - charge CPU time to the uid of a task
+ * @p: the task the time was accounted to
+ * @cputime: the time
+ *
+ * Called from the scheduler tick, on the CPU @p ran on.
+ */
+void cpufreq_account_uid_time(struct task_struct *p, cputime_t cputime)
+{
+	struct uid_entry *entry;
+	unsigned long flags;
+	int index;
+	uid_t uid;
+
+	index = per_cpu(uid_freq_index, task_cpu(p));
+	if (index < 0)
+		return;
+
+	rcu_read_lock();
+	uid = task_uid(p);
+	rcu_read_unlock();
+
+	spin_lock_irqsave(&uid_stat_lock, flags);
+	entry = find_or_create_uid_entry(uid);
+	if (entry)
+		entry->time_in_state[index] =
+			cputime64_add(entry->time_in_state[index],
+				      cputime_to_cputime64(cputime));
+	spin_unlock_irqrestore(&uid_stat_lock, flags);
+}
+
+static void uid_stat_set_cpu_freq(unsigned int cpu, unsigned int freq)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&uid_stat_lock, flags);
+	per_cpu(uid_freq_index, cpu) = uid_freq_get_index(freq);
+	spin_unlock_irqrestore(&uid_stat_lock, flags);
+}
+
+static int uid_stat_create_freqs(struct cpufreq_frequency_table *table)
+{
+	unsigned int *freqs;
+	unsigned int i, count = 0;
+	unsigned long flags;
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++)
+		if (table[i].frequency != CPUFREQ_ENTRY_INVALID)
+			count++;
+
+	freqs = kmalloc(count * sizeof(*freqs), GFP_KERNEL);
+	if (!freqs)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&uid_stat_lock, flags);
+	if (uid_freqs) {
+		/* someone else was first */
+		spin_unlock_irqrestore(&uid_stat_lock, flags);
+		kfree(freqs);
+		return 0;
+	}
+	uid_freqs = freqs;
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		unsigned int freq = table[i].frequency;
+
+		if (freq == CPUFREQ_ENTRY_INVALID)
+			continue;
+		if (uid_freq_get_index(freq) == -1)
+			uid_freqs[nr_uid_freqs++] = freq;
+	}
+	spin_unlock_irqrestore(&uid_stat_lock, flags);
+	return 0;
+}
+
+static int uid_stat_notifier_policy(struct notifier_block *nb,
+				    unsigned long val, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	struct cpufreq_frequency_table *table;
+	unsigned int cpu;
+	int ret;
+
+	if (val != CPUFREQ_NOTIFY)
+		return 0;
+
+	if (!uid_freqs) {
+		table = cpufreq_frequency_get_table(policy->cpu);
+		if (!table)
+			return 0;
+		ret = uid_stat_create_freqs(table);
+		if (ret)
+			return ret;
+	}
+
+	for_each_cpu(cpu, policy->cpus)
+		uid_stat_set_cpu_freq(cpu, policy->cur);
+	return 0;
+}
+
+static int uid_stat_notifier_trans(struct notifier_block *nb,
+				   unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freq = data;
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return 0;
+
+	uid_stat_set_cpu_freq(freq->cpu, freq->new);
+	return 0;
+}
+
+static struct notifier_block uid_stat_policy_nb = {
+	.notifier_call = uid_stat_notifier_policy,
+};
+
+static struct notifier_block uid_stat_trans_nb = {
+	.notifier_call = uid_stat_notifier_trans,
+};
+
+/*
+ * The file is read from a snapshot taken at open time, so that a reader
+ * sees a consistent set of uids however small its reads are.
+ */
+struct uid_time_snapshot {
+	size_t size;
+	u32 data[0];
+};
+
+static int uid_time_in_state_open(struct inode *inode, struct file *file)
+{
+	struct uid_time_snapshot *snap;
+	struct uid_entry *entry;
+	unsigned long flags;
+	unsigned int count, nr_freqs, i;
+	size_t size;
+	u32 *p;
+
+again:
+	spin_lock_irqsave(&uid_stat_lock, flags);
+	count = nr_uids;
+	nr_freqs = nr_uid_freqs;
+	spin_unlock_irqrestore(&uid_stat_lock, flags);
+
+	size = (1 + nr_freqs + count * (1 + nr_freqs)) * sizeof(u32);
+	snap = vmalloc(sizeof(*snap) + size);
+	if (!snap)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&uid_stat_lock, flags);
+	if (nr_uids != count || nr_uid_freqs != nr_freqs) {
+		/* changed meanwhile, do not leave anything out */
+		spin_unlock_irqrestore(&uid_stat_lock, flags);
+		vfree(snap);
+		goto again;
+	}
+
+	p = snap->data;
+	*p++ = nr_uid_freqs;
+	for (i = 0; i < nr_uid_freqs; i++)
+		*p++ = uid_freqs[i];
+	list_for_each_entry(entry, &uid_list, link) {
+		*p++ = entry->uid;
+		for (i = 0; i < nr_uid_freqs; i++)
+			*p++ = (u32)cputime64_to_clock_t(
+					entry->time_in_state[i]);
+	}
+	spin_unlock_irqrestore(&uid_stat_lock, flags);
+
+	snap->size = size;
+	file->private_data = snap;
+	return 0;
+}
+
+static ssize_t uid_time_in_state_read(struct file *file, char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct uid_time_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, snap->data,
+				       snap->size);
+}
+
+static int uid_time_in_state_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations uid_time_in_state_fops = {
+	.open		= uid_time_in_state_open,
+	.read		= uid_time_in_state_read,
+	.llseek		= generic_file_llseek,
+	.release	= uid_time_in_state_release,
+};
+
+static int __init cpufreq_uid_stat_init(void)
+{
+	unsigned int cpu;
+	int ret;
+
+	ret = cpufreq_register_notifier(&uid_stat_policy_nb,
+					CPUFREQ_POLICY_NOTIFIER);
+	if (ret)
+		return ret;
+
+	ret = cpufreq_register_notifier(&uid_stat_trans_nb,
+					CPUFREQ_TRANSITION_NOTIFIER);
+	if (ret) {
+		cpufreq_unregister_notifier(&uid_stat_policy_nb,
+					    CPUFREQ_POLICY_NOTIFIER);
+		return ret;
+	}
+
+	/* pick up the policies of cpufreq drivers registered before us */
+	for_each_online_cpu(cpu)
+		cpufreq_update_policy(cpu);
+
+	if (!proc_create("uid_time_in_state", S_IRUGO, NULL,
+			 &uid_time_in_state_fops))
+		pr_err("cpufreq_uid_stat: failed to create proc entry\n");
+	return 0;
+}
+late_initcall(cpufreq_uid_stat_init);
@@ -674,6 +674,8 @@ ssize_t DirectRead (struct file* filp, char* buf, size_t count, loff_t* f_pos)
         return -EFAULT;
     }
 
+    commbuff_stat_copy(commbuffsize);
+
     LOGCOMMBUFF_CH(minor, "DirectRead( )-->", commbuff, commbuffsize);
 
     free_commbuff(commbuff);
@@ -724,6 +726,8 @@ ssize_t DirectWrite (struct file* filp, const char* buf, size_t count, loff_t* f
         return -EFAULT;
     }
 
+    commbuff_stat_copy(count);
+
     result = SendData(minor, commbuff, NULL, direct->mux);
     if(result != ERROR_NONE)
     {
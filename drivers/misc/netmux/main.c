@@ -99,6 +99,7 @@ static int __init netmux_init(void)
     }
 
     NetmuxLogInit();
+    NetmuxStatsInit();
 
     wake_lock_init(&netmux_send_wakelock, WAKE_LOCK_SUSPEND, "NETMUX_send");
     wake_lock_init(&netmux_receive_wakelock, WAKE_LOCK_SUSPEND, "NETMUX_receive");
@@ -115,6 +116,7 @@ static void __exit netmux_exit(void)
     printk("Cleaning Up NetMUX\n");
     while(interfacelist)
         DeactivateMUX(interfacelist);
+    NetmuxStatsExit();
     shutdown_utilities();
 
     wake_lock_destroy(&netmux_send_wakelock);
@@ -1091,6 +1091,8 @@ void ReceiveData (MUX* mux)
     /* get rid of the header before it goes on the channel queue */
     commbuff_remove_front(databuffer, sizeof(DATA_PACKET_HDR));
 
+    commbuff_stat_inc(rx_frames);
+
     queue_commbuff(databuffer, &channel->receive_queue);
 
     exit_write_criticalsection(&mux->lock);
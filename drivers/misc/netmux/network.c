@@ -430,6 +430,8 @@ void NetworkInit (struct net_device* netdev)
     DEBUG("NetworkInit(0x%p)\n", netdev);
 
     netdev->hard_header_len = 0;
+    /* leave room for the data header so it can be pushed in place */
+    netdev->needed_headroom = sizeof(DATA_PACKET_HDR);
     netdev->addr_len        = 0;
     netdev->mtu             = 1500;
     netdev->tx_queue_len    = 1000; /* determine appropriate value */
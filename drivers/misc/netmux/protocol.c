@@ -74,6 +74,8 @@ void ApplyDataHdr (int8 channel, COMMBUFF** commbuff, MUX* mux)
     commbuff_add_header(cb, &packetdatahdr, sizeof(DATA_PACKET_HDR));
     *commbuff = cb;
 
+    commbuff_stat_inc(tx_frames);
+
     chanlPtr->qed_totl_amount += sizeof(DATA_PACKET_HDR);
     mux->total_queued_amount  += sizeof(DATA_PACKET_HDR);
 }
@@ -63,6 +63,8 @@ static struct proc_dir_entry *proc_netmux_log_entry = NULL;
 char *NetmuxLogState = NULL;
 static int GetNetmuxLogState(char *buf, char**start, off_t offset, int count,int *eof, void *data);
 static int WriteNetmuxLogCommand(struct file* file, const char* buffer, unsigned long count, void* data);
+static struct proc_dir_entry *proc_netmux_stats_entry = NULL;
+static int GetNetmuxStats(char *buf, char**start, off_t offset, int count,int *eof, void *data);
 /*
  * Declare a list to hold each registered interface
  */
@@ -339,3 +341,42 @@ void NetmuxLogInit(void)
         proc_netmux_log_entry->owner = THIS_MODULE;
     }
 }
+
+/*
+ * GetNetmuxStats is a read callback function of proc interface on NetMUX.
+ * It reports the commbuff allocation and copy counters.
+ */
+
+static int GetNetmuxStats(char *buf, char**start, off_t offset, int count,int *eof, void *data)
+{
+    int len;
+
+    len = sprintf(buf,
+                  "allocs: %d\nclones: %d\ncopies: %d\ncopy_bytes: %d\n"
+                  "tag_allocs: %d\nrx_frames: %d\ntx_frames: %d\n",
+                  atomic_read(&commbuff_stats.allocs),
+                  atomic_read(&commbuff_stats.clones),
+                  atomic_read(&commbuff_stats.copies),
+                  atomic_read(&commbuff_stats.copy_bytes),
+                  atomic_read(&commbuff_stats.tag_allocs),
+                  atomic_read(&commbuff_stats.rx_frames),
+                  atomic_read(&commbuff_stats.tx_frames));
+    *eof = 1;
+    return len;
+}
+
+void NetmuxStatsInit(void)
+{
+    proc_netmux_stats_entry = create_proc_entry("netmuxstats", 0444, 0);
+    if (proc_netmux_stats_entry)
+    {
+        proc_netmux_stats_entry->read_proc = GetNetmuxStats;
+        proc_netmux_stats_entry->owner = THIS_MODULE;
+    }
+}
+
+void NetmuxStatsExit(void)
+{
+    if (proc_netmux_stats_entry)
+        remove_proc_entry("netmuxstats", 0);
+}
@@ -125,5 +125,7 @@ int32 UnregisterMUXLink (void*);
 int32 ActivateMUX       (MUX*, INTERFACELIST*);
 void  DeactivateMUX     (INTERFACELIST*);
 void  NetmuxLogInit	(void);
+void  NetmuxStatsInit	(void);
+void  NetmuxStatsExit	(void);
 
 #endif
@@ -681,6 +681,7 @@ ssize_t TTYWrite (struct tty_struct* tty, const unsigned char* buf, int count)
     {
         commbuff = alloc_commbuff(amount_written, sizeof(DATA_PACKET_HDR));
         memcpy(commbuff_data(commbuff), buf, amount_written);
+        commbuff_stat_copy(amount_written);
         queue_commbuff(commbuff, &chdat->process_queue);
 	chdat->data_amount += commbuff_length(commbuff);
         RunSend(ttyif->mux);
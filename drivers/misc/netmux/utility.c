@@ -53,6 +53,9 @@
 #define COMMBUFF_TAG_INDEX_COUNT         4
 #define GET_COMMBUFF_TAG_INDEX(commbuff) (((int32)(commbuff)>>5)&(COMMBUFF_TAG_INDEX_COUNT-1))
 
+/* number of released tags kept around for reuse by tag_commbuff */
+#define COMMBUFF_TAG_POOL_SIZE           64
+
 #define LOG_COMMAND_ALL_WORK 49
 #define LOG_COMMAND_BUFFER 50
 #define LOG_COMMAND_FUNCTION 51
@@ -65,6 +68,10 @@ typedef struct LOCALTASK
 
 static COMMBUFFTAG* commbuff_tags[COMMBUFF_TAG_INDEX_COUNT] = {0};
 static COMMBUFFTAG* released_tagged_commbuffs               = 0;
+static COMMBUFFTAG* free_commbuff_tags                      = 0;
+static int32        free_commbuff_tag_count                 = 0;
+
+COMMBUFFSTATS commbuff_stats;
 
 static LOCALTASK tagged_commbuff_release_task;
 
@@ -80,7 +87,73 @@ void initialize_utilities (void)
 
 void shutdown_utilities (void)
 {
+    COMMBUFFTAG* freetag;
+
     destroy_task(&tagged_commbuff_release_task.releasetask);
+
+    while(free_commbuff_tags)
+    {
+        freetag            = free_commbuff_tags;
+        free_commbuff_tags = freetag->next_tag;
+
+        free_mem(freetag);
+    }
+
+    free_commbuff_tag_count = 0;
+}
+
+/*
+ * alloc_commbuff_tag takes a tag from the pool of released tags, falling
+ * back to an atomic allocation when the pool is empty
+ */
+static COMMBUFFTAG* alloc_commbuff_tag (void)
+{
+    INTERRUPT_STATE state;
+    COMMBUFFTAG*    newtag;
+
+    disable_interrupts(state);
+
+    newtag = free_commbuff_tags;
+    if(newtag)
+    {
+        free_commbuff_tags = newtag->next_tag;
+        free_commbuff_tag_count--;
+    }
+
+    enable_interrupts(state);
+
+    if(!newtag)
+    {
+        commbuff_stat_inc(tag_allocs);
+        newtag = (COMMBUFFTAG*)int_alloc_mem(sizeof(COMMBUFFTAG));
+    }
+
+    return newtag;
+}
+
+/*
+ * free_commbuff_tag returns a tag to the pool, freeing it if the pool
+ * is already full
+ */
+static void free_commbuff_tag (COMMBUFFTAG* freetag)
+{
+    INTERRUPT_STATE state;
+
+    disable_interrupts(state);
+
+    if(free_commbuff_tag_count < COMMBUFF_TAG_POOL_SIZE)
+    {
+        freetag->next_tag  = free_commbuff_tags;
+        free_commbuff_tags = freetag;
+        free_commbuff_tag_count++;
+
+        freetag = 0;
+    }
+
+    enable_interrupts(state);
+
+    if(freetag)
+        free_mem(freetag);
 }
 
 /*
@@ -142,7 +215,7 @@ void ProcessReleasedCommBuffs (struct work_struct *work)
         freetag = taginfo;
         taginfo = taginfo->next_tag;
 
-        free_mem(freetag);
+        free_commbuff_tag(freetag);
     }
 }
 
@@ -194,6 +267,8 @@ COMMBUFF* int_alloc_commbuff (int32 size)
         PANIC(netmuxPanicSKBFail1,
               "NetMUX PANIC: Unable to allocate commbuff\n");
 
+    commbuff_stat_inc(allocs);
+
     skb_put(newcommbuff, size);
 
     return newcommbuff;
@@ -214,6 +289,8 @@ COMMBUFF* alloc_commbuff (int32 size, int32 headroom)
         PANIC(netmuxPanicSKBFail2,
               "NetMUX PANIC: Unable to allocate commbuff\n");
 
+    commbuff_stat_inc(allocs);
+
     skb_reserve(newcommbuff, headroom);
 
     skb_put(newcommbuff, size);
@@ -240,6 +317,8 @@ COMMBUFF* commbuff_split (COMMBUFF* orig, int32 off)
         PANIC(netmuxPanicSKBFail3,
               "NetMUX PANIC: Unable to allocate commbuff\n");
 
+    commbuff_stat_inc(clones);
+
     skb_trim(orig, off);
     skb_pull(splitbuff, off);
 
@@ -250,39 +329,90 @@ COMMBUFF* commbuff_split (COMMBUFF* orig, int32 off)
  * commbuff_merge merges two commbuffs together
  * focus is where source is being merged to
  * source is what is being merged into focus
+ *
+ * The smaller side is copied whenever possible: focus is appended into
+ * its own tailroom, or prepended into the headroom of source when focus
+ * is only a fragment of a header. A new commbuff is only allocated when
+ * neither has room.
  */
 COMMBUFF* commbuff_merge (COMMBUFF* focus, COMMBUFF* source)
 {
     COMMBUFF* newcommbuff;
     sint8*     data;
+    int32      prepend;
+
+    prepend = skb_headroom(source) >= focus->len &&
+              !skb_shared(source) && !skb_header_cloned(source);
 
-    if(skb_tailroom(focus) >= source->len)
+    if(skb_tailroom(focus) >= source->len &&
+       (!prepend || focus->len >= source->len))
     {
         data = skb_put(focus, source->len);
 
         memcpy(data, source->data, source->len);
+        commbuff_stat_copy(source->len);
         kfree_skb(source);
 
         return focus;
     }
 
+    if(prepend)
+    {
+        data = skb_push(source, focus->len);
+
+        memcpy(data, focus->data, focus->len);
+        commbuff_stat_copy(focus->len);
+        kfree_skb(focus);
+
+        return source;
+    }
+
     newcommbuff = alloc_skb(focus->len+source->len, GFP_ATOMIC);
     if(!newcommbuff)
         PANIC(netmuxPanicSKBFail4,
               "NetMUX PANIC: Unable to allocate commbuff\n");
 
+    commbuff_stat_inc(allocs);
+
     data = skb_put(newcommbuff, focus->len);
     memcpy(data, focus->data, focus->len);
 
     data = skb_put(newcommbuff, source->len);
     memcpy(data, source->data, source->len);
 
+    commbuff_stat_copy(focus->len+source->len);
+
     kfree_skb(focus);
     kfree_skb(source);
 
     return newcommbuff;
 }
 
+/*
+ * commbuff_add_header places a header in front of the data in a commbuff.
+ * Interfaces allocate (or ask the network stack for) enough headroom so
+ * the header normally goes in place; the data is only reallocated when
+ * the headroom is missing or shared with a clone.
+ * ptr is the commbuff to add the header to
+ * hdr is the header
+ * amount is the size of the header
+ */
+void commbuff_add_header (COMMBUFF* ptr, void* hdr, int32 amount)
+{
+    if(skb_headroom(ptr) < amount || skb_header_cloned(ptr))
+    {
+        if(skb_cow_head(ptr, amount))
+            PANIC(netmuxPanicSKBFail5,
+                  "NetMUX PANIC: Unable to allocate commbuff\n");
+
+        commbuff_stat_inc(allocs);
+        commbuff_stat_copy(ptr->len);
+    }
+
+    skb_push(ptr, amount);
+    memcpy(ptr->data, hdr, amount);
+}
+
 void tag_commbuff (COMMBUFF* commbuff, int32 channel, void* param, void (*release)(int32, int32, void*))
 {
     INTERRUPT_STATE state;
@@ -291,7 +421,7 @@ void tag_commbuff (COMMBUFF* commbuff, int32 channel, void* param, void (*releas
 
     index = GET_COMMBUFF_TAG_INDEX(commbuff);
 
-    newtag = (COMMBUFFTAG*)int_alloc_mem(sizeof(COMMBUFFTAG));
+    newtag = alloc_commbuff_tag();
 
     newtag->channel         = channel;
     newtag->commbuff        = commbuff;
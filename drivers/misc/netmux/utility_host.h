@@ -116,6 +116,38 @@ typedef struct COMMBUFFTAG
     struct COMMBUFFTAG* next_tag;
 }COMMBUFFTAG;
 
+/*
+ * COMMBUFFSTATS counts the allocations and data copies made on behalf of
+ * commbuffs so that the data path can be checked for per-packet overhead.
+ * The description of this structure is:
+ *
+ * allocs: commbuffs allocated (including reallocations for headroom/merges)
+ * clones: commbuffs cloned to share data with another commbuff
+ * copies: payload copies into or out of a commbuff
+ * copy_bytes: the number of bytes moved by those copies
+ * tag_allocs: tags that could not be taken from the tag pool
+ * rx_frames: data packets delivered to a channel
+ * tx_frames: data packets queued for the link driver
+ */
+typedef struct COMMBUFFSTATS
+{
+    atomic_t allocs;
+    atomic_t clones;
+    atomic_t copies;
+    atomic_t copy_bytes;
+    atomic_t tag_allocs;
+    atomic_t rx_frames;
+    atomic_t tx_frames;
+}COMMBUFFSTATS;
+
+extern COMMBUFFSTATS commbuff_stats;
+
+#define commbuff_stat_inc(field)      atomic_inc(&commbuff_stats.field)
+#define commbuff_stat_copy(len)       { \
+                                        atomic_inc(&commbuff_stats.copies); \
+                                        atomic_add(len, &commbuff_stats.copy_bytes); \
+                                      }
+
 /*
  * The following declare routines for manipulating data inside a COMMBUFF
  */
@@ -129,11 +161,6 @@ COMMBUFF* alloc_commbuff     (int32, int32);
 #define commbuff_data(ptr)                   (ptr)->data
 #define commbuff_copyout(dst, cb, off, len)  memcpy(dst, ((cb)->data)+off, len)
 #define commbuff_remove_front(ptr, amount)   skb_pull(ptr, amount)
-/* the memcopys work because the skbuff is in contiguous memory */
-#define commbuff_add_header(ptr, hdr, amount)  { \
-                                                  skb_push(ptr, amount); \
-                                                  memcpy((ptr)->data, hdr, amount); \
-                                                }
 #define commbuff_copyin(cb, off, src, len)   memcpy((cb)->data+(off), src, len);
 #define commbuff_copyin_byte(ptr, off, val)  *((ptr)->data+off) = val
 #define commbuff_copyin_word(ptr, off, val)  *(int16*)((ptr)->data+off) = val
@@ -142,6 +169,7 @@ COMMBUFF* alloc_commbuff     (int32, int32);
 
 COMMBUFF* commbuff_split  (COMMBUFF*, int32);
 COMMBUFF* commbuff_merge  (COMMBUFF*, COMMBUFF*);
+void      commbuff_add_header (COMMBUFF*, void*, int32);
 void      tag_commbuff    (COMMBUFF*, int32, void*, void (*__cdecl)(int32, int32, void*));
 void      detag_commbuff  (COMMBUFF*);
 
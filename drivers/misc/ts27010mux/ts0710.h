@@ -259,8 +259,11 @@ struct dlci_struct {
 };
 
 struct chan_struct {
-	struct mutex	write_lock;
-	u8		*buf;
+	struct mutex		write_lock;
+	u8			*buf;
+
+	/* data written to /dev/muxN, waiting for its turn on the line */
+	struct ts27010_ringbuf	*txq;
 };
 
 
@@ -270,4 +273,11 @@ struct ts0710_con {
 
 	struct dlci_struct	dlci[TS0710_MAX_CHN];
 	struct chan_struct	chan[NR_MUXS];
+
+	/* FCOFF from the modem stops every channel */
+	int			flow_stopped;
+
+	/* round robins UIH frames from the txqs onto the line */
+	struct work_struct	tx_work;
+	int			tx_line;
 };
@@ -38,6 +38,27 @@ int ts27010_ldisc_send(struct tty_struct *tty, u8 *data, int len)
 	return len;
 }
 
+/*
+ * Returns nonzero if the uart can take len bytes right now.  If not, we
+ * ask to be woken up when it drains, so the mux transmitter can go idle
+ * instead of blocking every channel behind a full uart.
+ */
+int ts27010_ldisc_room(struct tty_struct *tty, int len)
+{
+	if (tty->driver->ops->write_room(tty) >= len)
+		return 1;
+
+	set_bit(TTY_DO_WRITE_WAKEUP, &tty->flags);
+
+	/* the uart may have drained before the bit was set */
+	if (tty->driver->ops->write_room(tty) >= len) {
+		clear_bit(TTY_DO_WRITE_WAKEUP, &tty->flags);
+		return 1;
+	}
+
+	return 0;
+}
+
 /*
  * Called when a tty is put into tx27010mux line discipline. Called in process
  * context.
@@ -178,7 +199,8 @@ static void ts27010_ldisc_receive(struct tty_struct *tty,
 
 static void ts27010_ldisc_wakeup(struct tty_struct *tty)
 {
-	pr_info(" Enter into ts27010mux_tty_wakeup. \n");
+	clear_bit(TTY_DO_WRITE_WAKEUP, &tty->flags);
+	ts27010_mux_tx_wakeup();
 }
 
 
@@ -40,7 +40,7 @@
  *
  * TODO:
  *	* test command
- *	* flow control
+ *	* convergence layer credit based flow control
  *	* support for non sholes
  */
 
@@ -124,16 +124,6 @@ static const struct dlci_tty dlci2tty[] = {
 	{15, 15},			/* DLCI 16 */
 };
 
-enum recv_state {
-	RECV_STATE_IDLE,
-	RECV_STATE_ADDR,
-	RECV_STATE_CONTROL,
-	RECV_STATE_LEN,
-	RECV_STATE_LEN2,
-	RECV_STATE_DATA,
-	RECV_STATE_END,
-};
-
 /* Bit number in flags of mux_send_struct */
 struct tty_struct *ts27010mux_tty;
 
@@ -301,14 +291,18 @@ static int ts0710_crc_check(u8 fcs)
 	return fcs == CRC_VALID;
 }
 
-static u8 ts0710_crc_data(u8 *data, int length)
+static u8 ts0710_crc_update(u8 fcs, const u8 *data, int length)
 {
-	u8 fcs = ts0710_crc_start();
-
 	while (length--)
-		fcs = ts0710_crc_calc(fcs, *data++);
+		fcs = crctable[fcs ^ *data++];
 
-	return ts0710_crc_end(fcs);
+	return fcs;
+}
+
+static u8 ts0710_crc_data(u8 *data, int length)
+{
+	return ts0710_crc_end(ts0710_crc_update(ts0710_crc_start(),
+						data, length));
 }
 
 static void ts0710_pkt_set_header(u8 *data, int len, int addr_ea,
@@ -461,18 +455,6 @@ static int ts27010_send_disc(struct ts0710_con *ts0710, u8 dlci)
 	return ts27010_send_cmd(ts0710, dlci, DISC);
 }
 
-static int ts27010_send_uih(struct ts0710_con *ts0710, u8 dlci,
-			    u8 *frame, u8 tag, const u8 *data, int len)
-{
-	ts_debug(DBG_CMD,
-		 "ts27010: sending %d length UIH packet to DLCI %d\n",
-		 len, dlci);
-	ts0710_pkt_set_header(frame, len+1, 1, MCC_CMD, dlci, CLR_PF(UIH));
-	*(u8 *)ts0710_pkt_data(frame) = tag;
-	memcpy(ts0710_pkt_data(frame)+1, data, len);
-	return ts0710_pkt_send(ts0710, frame);
-}
-
 static void ts27010_mcc_set_header(u8 *frame, int len, int cr, int cmd)
 {
 	struct mcc_short_frame *mcc_pkt;
@@ -604,7 +586,7 @@ static void ts27010_handle_msc(struct ts0710_con *ts0710, u8 type,
 				ts0710->dlci[dlci].state = CONNECTED;
 				ts_debug(DBG_CMD,
 					 "ts27010: flow on on dlci%d\n", dlci);
-				/* TODO: flow control not supported */
+				ts27010_mux_tx_wakeup();
 			}
 		}
 		ts27010_send_msc(ts0710, v24_sigs, MCC_RSP, dlci);
@@ -696,13 +678,20 @@ static void ts27010_handle_mcc(struct ts0710_con *ts0710, u8 control,
 	case FCON:
 		ts_debug(DBG_CMD,
 			 "ts27010: received all channels flow control on\n");
-		pr_warning("ts27010: flow control unimplemented\n");
+		if (mcc_is_cmd(type)) {
+			ts0710->flow_stopped = 0;
+			ts27010_send_fcon(ts0710, MCC_RSP);
+			ts27010_mux_tx_wakeup();
+		}
 		break;
 
 	case FCOFF:
 		ts_debug(DBG_CMD,
 			 "ts27010: received all channels flow control off\n");
-		pr_warning("ts27010: flow control unimplemented\n");
+		if (mcc_is_cmd(type)) {
+			ts0710->flow_stopped = 1;
+			ts27010_send_fcoff(ts0710, MCC_RSP);
+		}
 		break;
 
 	case MSC:
@@ -772,14 +761,11 @@ static void ts0710_flow_on(u8 dlci, struct ts0710_con *ts0710)
 	}
 }
 
-static void ts0710_flow_off(struct tty_struct *tty, u8 dlci,
-			    struct ts0710_con *ts0710)
+/* the tty layer has already set TTY_THROTTLED by the time we get here */
+static void ts0710_flow_off(u8 dlci, struct ts0710_con *ts0710)
 {
 	int i;
 
-	if (test_and_set_bit(TTY_THROTTLED, &tty->flags))
-		return;
-
 	if ((ts0710->dlci[0].state != CONNECTED)
 	    && (ts0710->dlci[0].state != FLOW_STOPPED))
 		return;
@@ -1206,15 +1192,106 @@ int ts27010_mux_active(void)
 	return ts27010mux_tty != NULL;
 }
 
+void ts27010_mux_tx_wakeup(void)
+{
+	schedule_work(&ts0710_connection.tx_work);
+}
+
+/*
+ * Send at most one UIH frame from line's txq.  Returns the payload
+ * length sent, 0 if the line has nothing it may send, or -EAGAIN if the
+ * uart is full (the ldisc wakes us once it drains).
+ */
+static int ts27010_mux_tx_frame(struct ts0710_con *ts0710, int line)
+{
+	struct chan_struct *ch = &ts0710->chan[line];
+	int dlci = tty2dlci[line];
+	struct dlci_struct *d = &ts0710->dlci[dlci];
+	u8 *frame = ch->buf;
+	int level;
+	int c;
+	u8 tag;
+
+	level = ts27010_ringbuf_level(ch->txq);
+	if (level == 0)
+		return 0;
+
+	/* a FLOW_STOPPED channel keeps its data and just loses its turn */
+	if (d->state != CONNECTED)
+		return 0;
+
+	c = min(level, d->mtu - 1);
+	if (!ts27010_ldisc_room(ts27010mux_tty, TS0710_FRAME_SIZE(c + 1)))
+		return -EAGAIN;
+
+	tag = iscmdtty[line] ? CMDTAG : DATATAG;
+
+	ts0710_pkt_set_header(frame, c + 1, 1, MCC_CMD, dlci, CLR_PF(UIH));
+	*(u8 *)ts0710_pkt_data(frame) = tag;
+	ts27010_ringbuf_read(ch->txq, 0, ts0710_pkt_data(frame) + 1, c);
+
+	ts_debug(DBG_CMD,
+		 "ts27010: sending %d length UIH packet to DLCI %d\n",
+		 c + 1, dlci);
+	if (tag == CMDTAG)
+		ts27010_debugstr(DBG_DATA, "ts27010: >C ",
+				 ts0710_pkt_data(frame) + 1, c);
+	else
+		ts27010_debughex(DBG_DATA, "ts27010: >D ",
+				 ts0710_pkt_data(frame) + 1, c);
+
+	ts0710_pkt_send(ts0710, frame);
+
+	ts27010_ringbuf_consume(ch->txq, c);
+	ts27010_tty_wakeup(line);
+
+	return c;
+}
+
+/*
+ * Each channel with queued data gets one frame per round, so a busy data
+ * channel can't hold AT command and SMS channels behind it, and a channel
+ * the modem flow-stopped is skipped without blocking the others.
+ */
+static void ts27010_mux_tx_worker(struct work_struct *work)
+{
+	struct ts0710_con *ts0710 =
+		container_of(work, struct ts0710_con, tx_work);
+	int line = ts0710->tx_line;
+	int idle = 0;
+	int sent;
+
+	while (idle < NR_MUXS) {
+		if (ts0710->flow_stopped || !ts27010mux_tty)
+			break;
+
+		sent = ts27010_mux_tx_frame(ts0710, line);
+		if (sent < 0)
+			break;
+
+		idle = sent ? 0 : idle + 1;
+		line = (line + 1) % NR_MUXS;
+	}
+
+	ts0710->tx_line = line;
+}
+
 
 int ts27010_mux_line_open(int line)
 {
+	struct ts0710_con *ts0710 = &ts0710_connection;
 	int dlci;
 
 	dlci = tty2dlci[line];
 
 	/* TODO: need to make sure channel 0 is open */
 
+	/* don't let data from an earlier session leak into this one */
+	if (ts0710->dlci[dlci].state == DISCONNECTED ||
+	    ts0710->dlci[dlci].state == REJECTED)
+		ts27010_ringbuf_consume(ts0710->chan[line].txq,
+			ts27010_ringbuf_level(ts0710->chan[line].txq));
+
 	return ts0710_open_channel(dlci);
 }
 
@@ -1227,185 +1304,164 @@ void ts27010_mux_line_close(int line)
 
 }
 
+/*
+ * Writes only queue data on the line's txq; the tx worker frames it.  A
+ * flow-stopped channel keeps accepting data until its txq fills, after
+ * which write_room() makes the tty layer wait for ts27010_tty_wakeup().
+ */
 int ts27010_mux_line_write(int line, const unsigned char *buf, int count)
 {
 	/* TODO: this should come from somewhere good */
 	struct ts0710_con *ts0710 = &ts0710_connection;
 	int dlci;
-	int err;
 	int c;
-	u8 tag;
 
 	dlci = tty2dlci[line];
-	if (ts0710->dlci[0].state == FLOW_STOPPED) {
-		/* TODO: this should block */
-		pr_info("Flow stopped on all channels, "
-			"returning zero /dev/mux%d\n",
-		     line);
-		return 0;
-	} else if (ts0710->dlci[dlci].state == FLOW_STOPPED) {
-		/* TODO: this should block */
-		pr_info("Flow stopped, returning zero /dev/mux%d\n", line);
-		return 0;
-	} else if (ts0710->dlci[dlci].state == CONNECTED) {
-		mutex_lock(&ts0710->chan[line].write_lock);
-
-		c = min(count, (ts0710->dlci[dlci].mtu - 1));
-		if (c <= 0) {
-			err = 0;
-			goto err;
-		}
-
-		ts_debug(DBG_VERBOSE, "ts27010: preparing to send %d bytes "
-			 "from /dev/mux%d\n", c, line);
-
-		if (iscmdtty[line]) {
-			ts27010_debugstr(DBG_DATA, "ts27010: >C ", buf, c);
-			ts_debug(DBG_VERBOSE, "CMDTAG\n");
-			tag = CMDTAG;
-		} else {
-			ts27010_debughex(DBG_DATA, "ts27010: >D ", buf, c);
-			ts_debug(DBG_VERBOSE, "DATATAG\n");
-			tag = DATATAG;
-		}
-
-		ts27010_send_uih(ts0710, dlci, ts0710->chan[line].buf,
-				 tag, buf, c);
-
-		mutex_unlock(&ts0710->chan[line].write_lock);
-
-		/*
-		 * TODO: should check write notify flag and call back
-		 * into the tty layer
-		 */
-
-		return c;
-	} else {
+	if (ts0710->dlci[dlci].state != CONNECTED &&
+	    ts0710->dlci[dlci].state != FLOW_STOPPED) {
 		pr_warning("ts27010: write on DLCI %d while not connected\n",
 			   dlci);
 		return -EDISCONNECTED;
 	}
 
-err:
+	mutex_lock(&ts0710->chan[line].write_lock);
+	c = ts27010_ringbuf_write(ts0710->chan[line].txq, buf, count);
 	mutex_unlock(&ts0710->chan[line].write_lock);
-	return err;
+
+	ts_debug(DBG_VERBOSE, "ts27010: queued %d of %d bytes "
+		 "from /dev/mux%d\n", c, count, line);
+
+	if (c > 0)
+		ts27010_mux_tx_wakeup();
+
+	return c;
 }
 
 int ts27010_mux_line_chars_in_buffer(int line)
 {
 	struct ts0710_con *ts0710 = &ts0710_connection;
 
-	if (mutex_is_locked(&ts0710->chan[line].write_lock))
-		return TS0710MUX_SERIAL_BUF_SIZE;
-	else
-		return 0;
+	return ts27010_ringbuf_level(ts0710->chan[line].txq);
 }
 
 int ts27010_mux_line_write_room(int line)
 {
 	struct ts0710_con *ts0710 = &ts0710_connection;
 
-	if (mutex_is_locked(&ts0710->chan[line].write_lock))
-		return 0;
-	else
-		return TS0710MUX_SERIAL_BUF_SIZE;
+	return ts27010_ringbuf_room(ts0710->chan[line].txq);
 }
 
+void ts27010_mux_line_throttle(int line)
+{
+	ts0710_flow_off(tty2dlci[line], &ts0710_connection);
+}
 
+void ts27010_mux_line_unthrottle(int line)
+{
+	ts0710_flow_on(tty2dlci[line], &ts0710_connection);
+}
+
+
+/* returns the offset of the first flag at or after idx, or count */
+static int ts27010_find_flag(struct ts27010_ringbuf *rbuf, int idx, int count)
+{
+	int n;
+	u8 *p;
+	u8 *flag;
+
+	while (idx < count) {
+		n = count - idx;
+		p = ts27010_ringbuf_span(rbuf, idx, &n);
+		flag = memchr(p, TS0710_BASIC_FLAG, n);
+		if (flag)
+			return idx + (flag - p);
+		idx += n;
+	}
+
+	return count;
+}
+
+/*
+ * Parse every complete frame in the ring buffer.  Rather than walking a
+ * byte at a time, we look for the opening flag a span at a time, read
+ * the (at most four byte) header in one go, check the FCS over it with
+ * one table walk, and hand payloads to the handlers still in place in
+ * the ring.  An incomplete frame is left for the next call.
+ */
 void ts27010_mux_recv(struct ts27010_ringbuf *rbuf)
 {
+	u8 hdr[TS0710_MAX_HDR_SIZE - 1];
 	int count;
-	int i;
-	u8 c;
-	int state = RECV_STATE_IDLE;
-	int consume_idx = -1;
-	int data_idx = 0;
-	u8 addr = 0;
-	u8 control = 0;
-	int len = 0;
-	u8 fcs = 0;
+	int start = 0;
+	int consumed = 0;
+	int hdr_len;
+	int data_idx;
+	int len;
+	int n;
+	u8 fcs;
 
 	count = ts27010_ringbuf_level(rbuf);
+	/* pairs with smp_wmb() in ts27010_ringbuf_write() */
+	smp_rmb();
 
-	for (i = 0; i < count; i++) {
-		c = ts27010_ringbuf_peek(rbuf, i);
-
-		switch (state) {
-		case RECV_STATE_IDLE:
-			if (c == TS0710_BASIC_FLAG) {
-				fcs = ts0710_crc_start();
-				state = RECV_STATE_ADDR;
-			} else {
-				consume_idx = i;
-			}
+	while (start < count) {
+		start = ts27010_find_flag(rbuf, start, count);
+		consumed = start;
+		if (start == count)
 			break;
 
-		case RECV_STATE_ADDR:
-			if (c != TS0710_BASIC_FLAG) {
-				fcs = ts0710_crc_calc(fcs, c);
-				addr = c;
-				state = RECV_STATE_CONTROL;
-			} else {
-				pr_warning(
-					"ts27010: RX wrong data. Drop msg.\n");
-				consume_idx = i;
-			}
+		/* address, control and the first length byte */
+		n = min(count - start - 1, (int)sizeof(hdr));
+		if (n < 3)
 			break;
+		ts27010_ringbuf_read(rbuf, start + 1, hdr, n);
 
-		case RECV_STATE_CONTROL:
-			fcs = ts0710_crc_calc(fcs, c);
-			control = c;
-			state = RECV_STATE_LEN;
-			break;
-
-		case RECV_STATE_LEN:
-			fcs = ts0710_crc_calc(fcs, c);
-			len = c>>1;
-			if (c & 0x1) {
-				data_idx = i+1;
-				state = RECV_STATE_DATA;
-			} else {
-				state = RECV_STATE_LEN2;
-			}
-			break;
+		/* a flag where the address belongs opens the frame anew */
+		if (hdr[0] == TS0710_BASIC_FLAG) {
+			start++;
+			continue;
+		}
 
-		case RECV_STATE_LEN2:
-			fcs = ts0710_crc_calc(fcs, c);
-			len |= c<<7;
-			data_idx = i+1;
-			if (len + data_idx >= LDISC_BUFFER_SIZE) {
-				pr_warning(
-					"ts27010: wrong length, Drop msg.\n");
-				state = RECV_STATE_IDLE;
-				consume_idx = i;
+		len = hdr[2] >> 1;
+		if (hdr[2] & EA) {
+			hdr_len = 3;
+		} else {
+			if (n < 4)
 				break;
-			}
-			state = RECV_STATE_DATA;
-			break;
+			len |= hdr[3] << 7;
+			hdr_len = 4;
+		}
 
-		case RECV_STATE_DATA:
-			if (i == data_idx+len) {
-				/* FCS byte */
-				fcs = ts0710_crc_calc(fcs, c);
-				state = RECV_STATE_END;
-			}
-			break;
+		data_idx = start + 1 + hdr_len;
+		if (len + 1 + hdr_len + FCS_SIZE + FLAG_SIZE >=
+		    LDISC_BUFFER_SIZE) {
+			pr_warning("ts27010: wrong length, Drop msg.\n");
+			start++;
+			continue;
+		}
 
-		case RECV_STATE_END:
-			if (c == TS0710_BASIC_FLAG && ts0710_crc_check(fcs)) {
-				ts27010_handle_frame(rbuf, addr, control,
-						      data_idx, len);
-			} else {
-				pr_warning("ts27010: lost synchronization\n");
-			}
-			consume_idx = i;
-			state = RECV_STATE_IDLE;
+		/* need the payload, FCS and closing flag */
+		if (data_idx + len + FCS_SIZE >= count)
 			break;
+
+		fcs = ts0710_crc_update(ts0710_crc_start(), hdr, hdr_len);
+		fcs = ts0710_crc_calc(fcs,
+				      ts27010_ringbuf_peek(rbuf, data_idx + len));
+
+		if (ts27010_ringbuf_peek(rbuf, data_idx + len + FCS_SIZE) ==
+		    TS0710_BASIC_FLAG && ts0710_crc_check(fcs)) {
+			ts27010_handle_frame(rbuf, hdr[0], hdr[1],
+					     data_idx, len);
+			start = data_idx + len + FCS_SIZE + 1;
+		} else {
+			/* resynchronize on the next flag */
+			pr_warning("ts27010: lost synchronization\n");
+			start++;
 		}
+		consumed = start;
 	}
 
-	ts27010_ringbuf_consume(rbuf, consume_idx+1);
-
+	ts27010_ringbuf_consume(rbuf, consumed);
 }
 
 static int __init mux_init(void)
@@ -1418,6 +1474,8 @@ static int __init mux_init(void)
 	for (j = 0; j < TS0710_MAX_CHN; j++)
 		mutex_init(&ts0710_connection.dlci[j].lock);
 
+	INIT_WORK(&ts0710_connection.tx_work, ts27010_mux_tx_worker);
+
 	for (j = 0; j < NR_MUXS; j++) {
 		ts0710_connection.chan[j].buf =
 			kmalloc(TS0710MUX_SEND_BUF_SIZE, GFP_KERNEL);
@@ -1426,6 +1484,13 @@ static int __init mux_init(void)
 			goto err0;
 		}
 
+		ts0710_connection.chan[j].txq =
+			ts27010_ringbuf_alloc(TS0710MUX_SERIAL_BUF_SIZE);
+		if (ts0710_connection.chan[j].txq == NULL) {
+			err = -ENOMEM;
+			goto err0;
+		}
+
 		mutex_init(&ts0710_connection.chan[j].write_lock);
 
 	}
@@ -1450,8 +1515,10 @@ err1:
 	ts27010_ldisc_remove();
 
 err0:
-	for (j = 0; j < NR_MUXS; j++)
+	for (j = 0; j < NR_MUXS; j++) {
 		kfree(ts0710_connection.chan[j].buf);
+		ts27010_ringbuf_free(ts0710_connection.chan[j].txq);
+	}
 
 	return err;
 }
@@ -1460,11 +1527,15 @@ static void __exit mux_exit(void)
 {
 	int j;
 
-	for (j = 0; j < NR_MUXS; j++)
-		kfree(&ts0710_connection.chan[j].buf);
-
 	ts27010_tty_remove();
 	ts27010_ldisc_remove();
+
+	flush_scheduled_work();
+
+	for (j = 0; j < NR_MUXS; j++) {
+		kfree(ts0710_connection.chan[j].buf);
+		ts27010_ringbuf_free(ts0710_connection.chan[j].txq);
+	}
 }
 
 module_init(mux_init);
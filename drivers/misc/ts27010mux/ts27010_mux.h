@@ -58,11 +58,15 @@ void ts27010_mux_line_close(int line);
 int ts27010_mux_line_write(int line, const unsigned char *buf, int count);
 int ts27010_mux_line_chars_in_buffer(int line);
 int ts27010_mux_line_write_room(int line);
+void ts27010_mux_line_throttle(int line);
+void ts27010_mux_line_unthrottle(int line);
 void ts27010_mux_recv(struct ts27010_ringbuf *rbuf);
+void ts27010_mux_tx_wakeup(void);
 
 int ts27010_ldisc_init(void);
 void ts27010_ldisc_remove(void);
 int ts27010_ldisc_send(struct tty_struct *tty, u8 *data, int len);
+int ts27010_ldisc_room(struct tty_struct *tty, int len);
 
 
 int ts27010_tty_init(void);
@@ -70,5 +74,6 @@ void ts27010_tty_remove(void);
 int ts27010_tty_send(int line, u8 *data, int len);
 int ts27010_tty_send_rbuf(int line, struct ts27010_ringbuf *rbuf,
 			  int data_idx, int len);
+void ts27010_tty_wakeup(int line);
 
 
@@ -53,6 +53,38 @@ static inline u8 ts27010_ringbuf_peek(struct ts27010_ringbuf *rbuf, int i)
 	return rbuf->buf[(rbuf->tail + i) % rbuf->len];
 }
 
+/*
+ * Returns a pointer to the data at offset i from the tail.  *len is
+ * clipped to the number of bytes contiguous from there, so walking a
+ * region takes at most two calls.
+ */
+static inline u8 *ts27010_ringbuf_span(struct ts27010_ringbuf *rbuf,
+				       int i, int *len)
+{
+	int start = (rbuf->tail + i) % rbuf->len;
+
+	*len = min(*len, rbuf->len - start);
+
+	return &rbuf->buf[start];
+}
+
+static inline int ts27010_ringbuf_read(struct ts27010_ringbuf *rbuf,
+				       int i, u8 *data, int len)
+{
+	int count = 0;
+	int n;
+	u8 *p;
+
+	while (count < len) {
+		n = len - count;
+		p = ts27010_ringbuf_span(rbuf, i + count, &n);
+		memcpy(data + count, p, n);
+		count += n;
+	}
+
+	return count;
+}
+
 static inline int ts27010_ringbuf_consume(struct ts27010_ringbuf *rbuf,
 					  int count)
 {
@@ -77,11 +109,15 @@ static inline int ts27010_ringbuf_push(struct ts27010_ringbuf *rbuf, u8 datum)
 static inline int ts27010_ringbuf_write(struct ts27010_ringbuf *rbuf,
 					const u8 *data, int len)
 {
-	int count = 0;
-	int i;
+	int count = min(len, ts27010_ringbuf_room(rbuf));
+	int first = min(count, rbuf->len - rbuf->head);
+
+	memcpy(&rbuf->buf[rbuf->head], data, first);
+	memcpy(rbuf->buf, data + first, count - first);
 
-	for (i = 0; i < len; i++)
-		count += ts27010_ringbuf_push(rbuf, data[i]);
+	/* the reader must see the data before the new head */
+	smp_wmb();
+	rbuf->head = (rbuf->head + count) % rbuf->len;
 
 	return count;
 }
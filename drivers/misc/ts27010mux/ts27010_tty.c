@@ -45,6 +45,7 @@ int ts27010_tty_send_rbuf(int line, struct ts27010_ringbuf *rbuf,
 {
 	struct ts27010_tty_data *td = driver->driver_state;
 	struct tty_struct *tty = td->chan[line].tty;
+	int count;
 
 	if (!tty) {
 		pr_info("ts27010: mux%d no open.  discarding %d bytes\n",
@@ -52,12 +53,31 @@ int ts27010_tty_send_rbuf(int line, struct ts27010_ringbuf *rbuf,
 		return 0;
 	}
 
-	while (len--) {
-		char c = ts27010_ringbuf_peek(rbuf, data_idx++);
-		tty_insert_flip_char(tty, c, TTY_NORMAL);
+	/* straight from the ring into the flip buffer, a span at a time */
+	count = 0;
+	while (count < len) {
+		int n = len - count;
+		u8 *p = ts27010_ringbuf_span(rbuf, data_idx + count, &n);
+
+		n = tty_insert_flip_string(tty, p, n);
+		if (n == 0) {
+			pr_warning("ts27010: mux%d flip buffer full.  "
+				   "dropping %d bytes\n", line, len - count);
+			break;
+		}
+		count += n;
 	}
 	tty_flip_buffer_push(tty);
-	return len;
+	return count;
+}
+
+void ts27010_tty_wakeup(int line)
+{
+	struct ts27010_tty_data *td = driver->driver_state;
+	struct tty_struct *tty = td->chan[line].tty;
+
+	if (tty)
+		tty_wakeup(tty);
 }
 
 static int ts27010_tty_open(struct tty_struct *tty, struct file *filp)
@@ -138,14 +158,12 @@ static int ts27010_tty_chars_in_buffer(struct tty_struct *tty)
 
 static void ts27010_tty_throttle(struct tty_struct *tty)
 {
-	pr_warning("ts27010: throttle not implemented on line %d\n",
-		tty->index);
+	ts27010_mux_line_throttle(tty->index);
 }
 
 static void ts27010_tty_unthrottle(struct tty_struct *tty)
 {
-	pr_warning("ts27010: unthrottle not implemented on line %d\n",
-		tty->index);
+	ts27010_mux_line_unthrottle(tty->index);
 }
 
 static int ts27010_tty_ioctl(struct tty_struct *tty, struct file *file,
@@ -99,6 +99,20 @@ static inline struct f_rndis *func_to_rndis(struct usb_function *f)
 	return container_of(f, struct f_rndis, port.func);
 }
 
+/* Multi-packet transfers cut per-packet USB and IRQ overhead when
+ * tethering.  Both default to the traditional one frame per transfer;
+ * the IN side is further limited by what the host says it accepts.
+ */
+static unsigned int rndis_ul_max_pkt_per_xfer = 1;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+	"max packets per OUT (host to device) transfer");
+
+static unsigned int rndis_dl_max_pkt_per_xfer = 1;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+	"max packets per IN (device to host) transfer");
+
 /* peak (theoretical) bulk transfer rate in bits-per-second */
 static unsigned int bitrate(struct usb_gadget *g)
 {
@@ -288,7 +302,13 @@ static struct usb_gadget_strings *rndis_strings[] = {
 
 static struct sk_buff *rndis_add_header(struct sk_buff *skb)
 {
-	skb = skb_realloc_headroom(skb, sizeof(struct rndis_packet_msg_type));
+	/* u_ether asks the stack for headroom, so usually we can frame
+	 * the skb in place instead of copying it
+	 */
+	if (skb_header_cloned(skb)
+			|| skb_headroom(skb) < sizeof(struct rndis_packet_msg_type))
+		skb = skb_realloc_headroom(skb,
+				sizeof(struct rndis_packet_msg_type));
 	if (skb)
 		rndis_add_hdr(skb);
 	return skb;
@@ -502,6 +522,11 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		 */
 		rndis->port.cdc_filter = 0;
 
+		/* host IN limit arrives with REMOTE_NDIS_INITIALIZE_MSG */
+		rndis->port.ul_max_pkts_per_xfer = rndis_ul_max_pkt_per_xfer;
+		rndis->port.dl_max_pkts_per_xfer = rndis_dl_max_pkt_per_xfer;
+		rndis->port.dl_max_xfer_size = 0;
+
 		DBG(cdev, "RNDIS RX/TX early activation ... \n");
 		net = gether_connect(&rndis->port);
 		if (IS_ERR(net))
@@ -509,6 +534,9 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 
 		rndis_set_param_dev(rndis->config, net,
 				&rndis->port.cdc_filter);
+		rndis_set_param_max_xfer(rndis->config,
+				rndis->port.ul_max_pkts_per_xfer,
+				&rndis->port.dl_max_xfer_size);
 	} else
 		goto fail;
 
@@ -581,13 +581,17 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = __constant_cpu_to_le32 (RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = __constant_cpu_to_le32 (RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = __constant_cpu_to_le32 (RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = __constant_cpu_to_le32 (1);
-	resp->MaxTransferSize = cpu_to_le32 (
+	resp->MaxPacketsPerTransfer = cpu_to_le32 (params->max_pkt_per_xfer);
+	resp->MaxTransferSize = cpu_to_le32 (params->max_pkt_per_xfer * (
 		  params->dev->mtu
 		+ sizeof (struct ethhdr)
 		+ sizeof (struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = __constant_cpu_to_le32 (0);
+
+	/* the host's limit bounds how many frames we pack per IN transfer */
+	if (params->dl_max_xfer_size)
+		*params->dl_max_xfer_size = le32_to_cpu(buf->MaxTransferSize);
 	resp->AFListOffset = __constant_cpu_to_le32 (0);
 	resp->AFListSize = __constant_cpu_to_le32 (0);
 
@@ -932,6 +936,19 @@ int rndis_set_param_dev(u8 configNr, struct net_device *dev, u16 *cdc_filter)
 	return 0;
 }
 
+int rndis_set_param_max_xfer(u8 configNr, u32 max_pkt_per_xfer,
+		u32 *dl_max_xfer_size)
+{
+	pr_debug("%s: %u\n", __func__, max_pkt_per_xfer);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params [configNr].max_pkt_per_xfer =
+			max_pkt_per_xfer ? : 1;
+	rndis_per_dev_params [configNr].dl_max_xfer_size = dl_max_xfer_size;
+
+	return 0;
+}
+
 int rndis_set_param_vendor (u8 configNr, u32 vendorID, const char *vendorDescr)
 {
 	pr_debug("%s:\n", __func__);
@@ -1023,23 +1040,64 @@ static rndis_resp_t *rndis_add_response (int configNr, u32 length)
 	return r;
 }
 
-int rndis_rm_hdr(struct sk_buff *skb)
+/*
+ * Split one OUT transfer into its REMOTE_NDIS_PACKET_MSG frames.  All but
+ * the last frame are clones sharing the transfer's buffer, so nothing is
+ * copied; trailing padding shorter than a header is ignored.  The skb is
+ * consumed, even on error.
+ */
+int rndis_rm_hdr(struct sk_buff *skb, struct sk_buff_head *list)
 {
 	/* tmp points to a struct rndis_packet_msg_type */
-	__le32		*tmp = (void *) skb->data;
+	__le32		*tmp;
+	u32		msg_len, data_offset, data_len;
+	struct sk_buff	*skb2;
+	int		status = 0;
+
+	while (skb->len >= sizeof(struct rndis_packet_msg_type)) {
+		tmp = (void *) skb->data;
+
+		/* MessageType, MessageLength */
+		if (__constant_cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++)) {
+			status = -EINVAL;
+			break;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++) + 8;
+		data_len = get_unaligned_le32(tmp++);
+		if (msg_len < sizeof(struct rndis_packet_msg_type)
+				|| msg_len > skb->len
+				|| data_offset > msg_len
+				|| data_len > msg_len - data_offset) {
+			status = -EOVERFLOW;
+			break;
+		}
 
-	/* MessageType, MessageLength */
-	if (__constant_cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++))
-		return -EINVAL;
-	tmp++;
+		/* last frame in this transfer keeps the original skb */
+		if (skb->len - msg_len < sizeof(struct rndis_packet_msg_type)) {
+			skb_pull(skb, data_offset);
+			skb_trim(skb, data_len);
+			skb_queue_tail(list, skb);
+			return 0;
+		}
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8))
-		return -EOVERFLOW;
-	skb_trim(skb, get_unaligned_le32(tmp++));
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			status = -ENOMEM;
+			break;
+		}
+		skb_pull(skb2, data_offset);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
 
-	return 0;
+		skb_pull(skb, msg_len);
+	}
+
+	dev_kfree_skb_any(skb);
+	return status ? : -EINVAL;
 }
 
 #ifdef	CONFIG_USB_GADGET_DEBUG_FILES
@@ -1168,6 +1226,7 @@ int __init rndis_init (void)
 		rndis_per_dev_params [i].state = RNDIS_UNINITIALIZED;
 		rndis_per_dev_params [i].media_state
 				= NDIS_MEDIA_STATE_DISCONNECTED;
+		rndis_per_dev_params [i].max_pkt_per_xfer = 1;
 		INIT_LIST_HEAD (&(rndis_per_dev_params [i].resp_queue));
 	}
 
@@ -234,6 +234,12 @@ typedef struct rndis_params
 	u16			*filter;
 	struct net_device	*dev;
 
+	/* multi-packet transfers: how many frames we accept per OUT
+	 * transfer, and where to record the host's IN transfer limit
+	 */
+	u32			max_pkt_per_xfer;
+	u32			*dl_max_xfer_size;
+
 	u32			vendorID;
 	const char		*vendorDescr;
 	void			(*resp_avail)(void *v);
@@ -250,8 +256,10 @@ int  rndis_set_param_dev (u8 configNr, struct net_device *dev,
 int  rndis_set_param_vendor (u8 configNr, u32 vendorID,
 			    const char *vendorDescr);
 int  rndis_set_param_medium (u8 configNr, u32 medium, u32 speed);
+int  rndis_set_param_max_xfer (u8 configNr, u32 max_pkt_per_xfer,
+			 u32 *dl_max_xfer_size);
 void rndis_add_hdr (struct sk_buff *skb);
-int rndis_rm_hdr (struct sk_buff *skb);
+int rndis_rm_hdr(struct sk_buff *skb, struct sk_buff_head *list);
 u8   *rndis_get_next_response (int configNr, u32 *length);
 void rndis_free_response (int configNr, u8 *buf);
 
@@ -70,7 +70,21 @@ struct eth_dev {
 
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct sk_buff *skb);
-	int			(*unwrap)(struct sk_buff *skb);
+	int			(*unwrap)(struct sk_buff *skb,
+					struct sk_buff_head *list);
+
+	/* multi-packet transfers; tx_req_pending collects frames
+	 * while earlier IN transfers are still in flight.
+	 */
+	unsigned		ul_max_pkts_per_xfer;
+	unsigned		dl_max_pkts_per_xfer;
+	unsigned		tx_buf_size;
+	struct usb_request	*tx_req_pending;
+	unsigned		tx_pending_pkts;
+
+	struct sk_buff_head	rx_frames;
+	struct sk_buff_head	rx_recycle;	/* spare rx skbs */
+	unsigned		rx_skb_size;
 
 	struct work_struct	work;
 
@@ -87,6 +101,9 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+/* largest frame an IN transfer may carry, framing header included */
+#define TX_FRAME_MAX(dev)	((dev)->header_len + ETH_FRAME_LEN)
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -198,6 +215,30 @@ static void defer_kevent(struct eth_dev *dev, int flag)
 
 static void rx_complete(struct usb_ep *ep, struct usb_request *req);
 
+/* Reuse an rx skb from the recycle pool when one is available; those
+ * come from tx completions and from transfers that never reached the
+ * network stack.  They were checked against rx_skb_size when pooled.
+ */
+static struct sk_buff *rx_alloc_skb(struct eth_dev *dev, gfp_t gfp_flags)
+{
+	struct sk_buff	*skb;
+
+	skb = skb_dequeue(&dev->rx_recycle);
+	if (skb)
+		return skb;
+	return __netdev_alloc_skb(dev->net, dev->rx_skb_size, gfp_flags);
+}
+
+static void rx_recycle(struct eth_dev *dev, struct sk_buff *skb)
+{
+	if (dev->rx_skb_size
+			&& skb_queue_len(&dev->rx_recycle) < qlen(dev->gadget)
+			&& skb_recycle_check(skb, dev->rx_skb_size))
+		skb_queue_head(&dev->rx_recycle, skb);
+	else
+		dev_kfree_skb_any(skb);
+}
+
 static int
 rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 {
@@ -231,11 +272,21 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 * new packets don't only start after a short RX).
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
-	size += dev->port_usb->header_len;
+	size += dev->header_len;
+	if (dev->ul_max_pkts_per_xfer > 1)
+		size *= dev->ul_max_pkts_per_xfer;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
-	skb = alloc_skb(size + NET_IP_ALIGN, gfp_flags);
+	/* the MTU can't change while we're connected, so neither can
+	 * the size of pooled skbs; just flush stale ones on a change
+	 */
+	if (dev->rx_skb_size != size + NET_IP_ALIGN) {
+		skb_queue_purge(&dev->rx_recycle);
+		dev->rx_skb_size = size + NET_IP_ALIGN;
+	}
+
+	skb = rx_alloc_skb(dev, gfp_flags);
 	if (skb == NULL) {
 		DBG(dev, "no rx skb\n");
 		goto enomem;
@@ -269,7 +320,7 @@ enomem:
 
 static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context;
+	struct sk_buff	*skb = req->context, *skb2;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
 
@@ -278,26 +329,57 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 	/* normal completion */
 	case 0:
 		skb_put(skb, req->actual);
-		if (dev->unwrap)
-			status = dev->unwrap(skb);
-		if (status < 0
-				|| ETH_HLEN > skb->len
-				|| skb->len > ETH_FRAME_LEN) {
-			dev->net->stats.rx_errors++;
-			dev->net->stats.rx_length_errors++;
-			DBG(dev, "rx length %d\n", skb->len);
-			break;
+
+		if (dev->unwrap) {
+			unsigned long	flags;
+
+			spin_lock_irqsave(&dev->lock, flags);
+			if (dev->port_usb) {
+				status = dev->unwrap(skb, &dev->rx_frames);
+				skb = NULL;
+			} else
+				status = -ENOTCONN;
+			spin_unlock_irqrestore(&dev->lock, flags);
+			if (skb) {
+				rx_recycle(dev, skb);
+				skb = NULL;
+			}
+		} else {
+			skb_queue_tail(&dev->rx_frames, skb);
+			skb = NULL;
 		}
 
-		skb->protocol = eth_type_trans(skb, dev->net);
-		dev->net->stats.rx_packets++;
-		dev->net->stats.rx_bytes += skb->len;
+		/* a bad frame ends the transfer; the frames before it
+		 * are fine and still get passed up
+		 */
+		if (status < 0) {
+			dev->net->stats.rx_errors++;
+			DBG(dev, "rx unwrap %d\n", status);
+		}
 
-		/* no buffer copies needed, unless hardware can't
-		 * use skb buffers.
+		/* one transfer may have carried several frames; those
+		 * share the transfer's buffer, so no copies are needed
+		 * unless hardware can't use skb buffers.
 		 */
-		status = netif_rx(skb);
-		skb = NULL;
+		skb2 = skb_dequeue(&dev->rx_frames);
+		while (skb2) {
+			if (ETH_HLEN > skb2->len
+					|| skb2->len > ETH_FRAME_LEN) {
+				dev->net->stats.rx_errors++;
+				dev->net->stats.rx_length_errors++;
+				DBG(dev, "rx length %d\n", skb2->len);
+				dev_kfree_skb_any(skb2);
+				goto next_frame;
+			}
+
+			skb2->protocol = eth_type_trans(skb2, dev->net);
+			dev->net->stats.rx_packets++;
+			dev->net->stats.rx_bytes += skb2->len;
+
+			status = netif_rx(skb2);
+next_frame:
+			skb2 = skb_dequeue(&dev->rx_frames);
+		}
 		break;
 
 	/* software-driven interface shutdown */
@@ -311,7 +393,7 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 		DBG(dev, "rx %s reset\n", ep->name);
 		defer_kevent(dev, WORK_RX_MEMORY);
 quiesce:
-		dev_kfree_skb_any(skb);
+		rx_recycle(dev, skb);
 		goto clean;
 
 	/* data overrun */
@@ -326,7 +408,7 @@ quiesce:
 	}
 
 	if (skb)
-		dev_kfree_skb_any(skb);
+		rx_recycle(dev, skb);
 	if (!netif_running(dev->net)) {
 clean:
 		spin_lock(&dev->req_lock);
@@ -396,6 +478,29 @@ done:
 	return status;
 }
 
+/* With multi-packet IN transfers, frames are packed into buffers owned
+ * by the requests themselves; otherwise requests point into skbs.
+ */
+static int alloc_tx_buffers(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		/* one spare byte, for zlp avoidance */
+		req->buf = kmalloc(dev->tx_buf_size + 1, GFP_ATOMIC);
+		if (!req->buf)
+			goto fail;
+	}
+	return 0;
+
+fail:
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+	return -ENOMEM;
+}
+
 static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 {
 	struct usb_request	*req;
@@ -432,10 +537,14 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static int tx_queue_req(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context;
-	struct eth_dev	*dev = ep->driver_data;
+	struct sk_buff		*skb = req->context;
+	struct eth_dev		*dev = ep->driver_data;
+	struct usb_request	*pending = NULL;
 
 	switch (req->status) {
 	default:
@@ -446,16 +555,30 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		/* aggregated transfers were counted as they were filled */
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+	if (skb)
+		dev->net->stats.tx_packets++;
 
+	/* frames that queued up behind this transfer go out now.
+	 * tx_qlen drops under the lock, so tx_aggregate() never leaves
+	 * a request pending with nothing in flight to flush it.
+	 */
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
+	pending = dev->tx_req_pending;
+	dev->tx_req_pending = NULL;
+	atomic_dec(&dev->tx_qlen);
 	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
 
-	atomic_dec(&dev->tx_qlen);
+	/* the skb may serve again as an rx buffer */
+	if (skb)
+		rx_recycle(dev, skb);
+
+	if (pending)
+		tx_queue_req(dev, ep, pending);
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
@@ -465,20 +588,161 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/* Hand one IN request to the hardware; on failure it goes back to
+ * the freelist.  Aggregated requests have no skb to free.
+ */
+static int tx_queue_req(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req)
+{
+	struct sk_buff	*skb = req->context;
+	unsigned long	flags;
+	int		retval;
+
+	/* use zlp framing on tx for strict CDC-Ether conformance,
+	 * though any robust network rx path ignores extra padding.
+	 * and some hardware doesn't like to write zlps.
+	 */
+	req->zero = 1;
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		req->length++;
+
+	/* throttle highspeed IRQ rate back slightly; an aggregated
+	 * transfer always interrupts, since frames wait on it.
+	 */
+	if (gadget_is_dualspeed(dev->gadget))
+		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH
+				&& skb)
+			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
+			: 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	switch (retval) {
+	default:
+		DBG(dev, "tx queue err %d\n", retval);
+		break;
+	case 0:
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+	}
+
+	if (retval) {
+		dev->net->stats.tx_dropped++;
+		if (skb)
+			dev_kfree_skb_any(skb);
+		spin_lock_irqsave(&dev->req_lock, flags);
+		if (list_empty(&dev->tx_reqs))
+			netif_start_queue(dev->net);
+		list_add(&req->list, &dev->tx_reqs);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+	}
+	return retval;
+}
+
+/* Pack a frame into the request being filled, starting a new one when
+ * it's full.  The filled request is sent right away if nothing else is
+ * in flight; otherwise it waits for the next tx completion, so frames
+ * accumulate exactly while the link is busy.
+ */
+static int tx_aggregate(struct eth_dev *dev, struct sk_buff *skb,
+		struct usb_ep *in, unsigned max_xfer)
+{
+	struct usb_request	*req, *full = NULL;
+	struct sk_buff		*skb_new;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_req_pending;
+	if (req && (req->length + skb->len + dev->header_len > max_xfer
+			|| dev->tx_pending_pkts >= dev->dl_max_pkts_per_xfer)) {
+		full = req;
+		dev->tx_req_pending = NULL;
+		req = NULL;
+	}
+
+	if (!req) {
+		/* see eth_start_xmit() about the freelist emptying */
+		if (list_empty(&dev->tx_reqs)) {
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			if (full)
+				tx_queue_req(dev, in, full);
+			return 1;
+		}
+		req = container_of(dev->tx_reqs.next,
+				struct usb_request, list);
+		list_del(&req->list);
+		if (list_empty(&dev->tx_reqs))
+			netif_stop_queue(dev->net);
+
+		req->length = 0;
+		req->context = NULL;
+		req->complete = tx_complete;
+		dev->tx_pending_pkts = 0;
+	}
+
+	if (dev->wrap) {
+		skb_new = dev->wrap(skb);
+		if (!skb_new)
+			goto drop;
+		if (skb_new != skb)
+			dev_kfree_skb_any(skb);
+		skb = skb_new;
+	}
+
+	/* the one copy on this path: into the request's own buffer */
+	memcpy(req->buf + req->length, skb->data, skb->len);
+	req->length += skb->len;
+	dev->tx_pending_pkts++;
+	dev->net->stats.tx_packets++;
+	dev->net->stats.tx_bytes += skb->len;
+
+	if (atomic_read(&dev->tx_qlen) == 0 && !full) {
+		full = req;
+		req = NULL;
+	}
+	dev->tx_req_pending = req;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any(skb);
+	if (full)
+		tx_queue_req(dev, in, full);
+	return 0;
+
+drop:
+	dev->net->stats.tx_dropped++;
+	if (req->length)
+		dev->tx_req_pending = req;
+	else {
+		if (list_empty(&dev->tx_reqs))
+			netif_start_queue(dev->net);
+		list_add(&req->list, &dev->tx_reqs);
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any(skb);
+	if (full)
+		tx_queue_req(dev, in, full);
+	return 0;
+}
+
 static int eth_start_xmit(struct sk_buff *skb, struct net_device *net)
 {
 	struct eth_dev		*dev = netdev_priv(net);
 	int			length = skb->len;
-	int			retval;
 	struct usb_request	*req = NULL;
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	unsigned		max_xfer = 0;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
+		if (dev->dl_max_pkts_per_xfer > 1) {
+			max_xfer = dev->port_usb->dl_max_xfer_size;
+			if (!max_xfer || max_xfer > dev->tx_buf_size)
+				max_xfer = dev->tx_buf_size;
+		}
 	} else {
 		in = NULL;
 		cdc_filter = 0;
@@ -512,6 +776,9 @@ static int eth_start_xmit(struct sk_buff *skb, struct net_device *net)
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (max_xfer)
+		return tx_aggregate(dev, skb, in, max_xfer);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -542,50 +809,28 @@ static int eth_start_xmit(struct sk_buff *skb, struct net_device *net)
 		if (!skb_new)
 			goto drop;
 
-		dev_kfree_skb_any(skb);
+		/* wrap() may have framed the skb in place */
+		if (skb_new != skb)
+			dev_kfree_skb_any(skb);
 		skb = skb_new;
 		length = skb->len;
 	}
 	req->buf = skb->data;
 	req->context = skb;
 	req->complete = tx_complete;
-
-	/* use zlp framing on tx for strict CDC-Ether conformance,
-	 * though any robust network rx path ignores extra padding.
-	 * and some hardware doesn't like to write zlps.
-	 */
-	req->zero = 1;
-	if (!dev->zlp && (length % in->maxpacket) == 0)
-		length++;
-
 	req->length = length;
 
-	/* throttle highspeed IRQ rate back slightly */
-	if (gadget_is_dualspeed(dev->gadget))
-		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH)
-			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
-			: 0;
-
-	retval = usb_ep_queue(in, req, GFP_ATOMIC);
-	switch (retval) {
-	default:
-		DBG(dev, "tx queue err %d\n", retval);
-		break;
-	case 0:
-		net->trans_start = jiffies;
-		atomic_inc(&dev->tx_qlen);
-	}
+	tx_queue_req(dev, in, req);
+	return 0;
 
-	if (retval) {
 drop:
-		dev->net->stats.tx_dropped++;
-		dev_kfree_skb_any(skb);
-		spin_lock_irqsave(&dev->req_lock, flags);
-		if (list_empty(&dev->tx_reqs))
-			netif_start_queue(net);
-		list_add(&req->list, &dev->tx_reqs);
-		spin_unlock_irqrestore(&dev->req_lock, flags);
-	}
+	dev->net->stats.tx_dropped++;
+	dev_kfree_skb_any(skb);
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty(&dev->tx_reqs))
+		netif_start_queue(net);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
 	return 0;
 }
 
@@ -751,6 +996,8 @@ int __init gether_setup(struct usb_gadget *g, u8 ethaddr[ETH_ALEN])
 	INIT_WORK(&dev->work, eth_work);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
+	skb_queue_head_init(&dev->rx_frames);
+	skb_queue_head_init(&dev->rx_recycle);
 
 	/* network device setup */
 	dev->net = net;
@@ -806,6 +1053,7 @@ void gether_cleanup(void)
 		return;
 
 	unregister_netdev(the_dev->net);
+	skb_queue_purge(&the_dev->rx_recycle);
 	free_netdev(the_dev->net);
 
 	/* assuming we used keventd, it must quiesce too */
@@ -866,6 +1114,24 @@ struct net_device *gether_connect(struct gether *link)
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
 
+		/* let the stack leave room for our framing */
+		dev->net->needed_headroom = link->header_len;
+
+		dev->ul_max_pkts_per_xfer = link->ul_max_pkts_per_xfer;
+		dev->dl_max_pkts_per_xfer = link->dl_max_pkts_per_xfer;
+		dev->tx_buf_size = 0;
+		if (dev->dl_max_pkts_per_xfer > 1) {
+			dev->tx_buf_size = dev->dl_max_pkts_per_xfer
+					* TX_FRAME_MAX(dev);
+			spin_lock(&dev->req_lock);
+			if (alloc_tx_buffers(dev) < 0) {
+				INFO(dev, "no memory for tx aggregation\n");
+				dev->dl_max_pkts_per_xfer = 1;
+				dev->tx_buf_size = 0;
+			}
+			spin_unlock(&dev->req_lock);
+		}
+
 		spin_lock(&dev->lock);
 		dev->port_usb = link;
 		link->ioport = dev;
@@ -927,12 +1193,18 @@ void gether_disconnect(struct gether *link)
 	 */
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_req_pending) {
+		list_add(&dev->tx_req_pending->list, &dev->tx_reqs);
+		dev->tx_req_pending = NULL;
+	}
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_buf_size)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
@@ -959,6 +1231,10 @@ void gether_disconnect(struct gether *link)
 	dev->header_len = 0;
 	dev->unwrap = NULL;
 	dev->wrap = NULL;
+	dev->net->needed_headroom = 0;
+	dev->ul_max_pkts_per_xfer = 0;
+	dev->dl_max_pkts_per_xfer = 0;
+	dev->tx_buf_size = 0;
 
 	spin_lock(&dev->lock);
 	dev->port_usb = NULL;
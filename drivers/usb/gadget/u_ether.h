@@ -61,11 +61,23 @@ struct gether {
 	u16				cdc_filter;
 
 	/* hooks for added framing, as needed for RNDIS and EEM.
-	 * we currently don't support multiple frames per SKB.
+	 * unwrap() may split one received transfer into several frames,
+	 * which it appends to @list (the original skb included).
 	 */
 	u32				header_len;
 	struct sk_buff			*(*wrap)(struct sk_buff *skb);
-	int				(*unwrap)(struct sk_buff *skb);
+	int				(*unwrap)(struct sk_buff *skb,
+						struct sk_buff_head *list);
+
+	/* multi-packet transfers, for framings that delimit frames
+	 * (like RNDIS).  Zero or one means "one frame per transfer".
+	 * ul_* sizes the OUT buffers, dl_* packs several frames into
+	 * each IN transfer, up to dl_max_xfer_size bytes (zero means
+	 * no host-imposed limit beyond what dl_max_pkts_per_xfer needs).
+	 */
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
 
 	/* called on network open/close */
 	void				(*open)(struct gether *);
@@ -281,6 +281,52 @@ static int au_do_copy_file(struct file *dst, struct file *src, loff_t len,
 	return err;
 }
 
+/*
+ * copy through the page cache by splice, without the bounce buffer and in
+ * much larger units than a block.
+ * holes are not detected, so this is for the dense files only.
+ */
+static int au_do_splice_file(struct file *dst, struct file *src, loff_t len)
+{
+	long err;
+	size_t sz;
+
+	err = 0;
+	while (len) {
+		sz = AuCpup_SPLICE_CHUNK;
+		if (len < sz)
+			sz = len;
+
+		/* todo: signal_pending? */
+		do {
+			err = vfsub_splice_direct(src, &src->f_pos, dst, sz,
+						  /*flags*/0);
+		} while (err == -EAGAIN || err == -EINTR);
+		if (unlikely(err <= 0)) {
+			if (!err)
+				err = -EIO; /* unexpected EOF */
+			break;
+		}
+
+		len -= err;
+		err = 0;
+	}
+
+	return err;
+}
+
+static int au_test_splice_file(struct file *dst, struct file *src, loff_t len)
+{
+	struct inode *h_inode;
+
+	h_inode = src->f_dentry->d_inode;
+	return len
+		&& src->f_op && src->f_op->splice_read
+		&& dst->f_op && dst->f_op->splice_write
+		/* a sparse file keeps its holes by au_do_copy_file() */
+		&& ((loff_t)h_inode->i_blocks << 9) >= i_size_read(h_inode);
+}
+
 int au_copy_file(struct file *dst, struct file *src, loff_t len)
 {
 	int err;
@@ -288,6 +334,16 @@ int au_copy_file(struct file *dst, struct file *src, loff_t len)
 	unsigned char do_kfree;
 	char *buf;
 
+	if (au_test_splice_file(dst, src, len)) {
+		src->f_pos = 0;
+		dst->f_pos = 0;
+		err = au_do_splice_file(dst, src, len);
+		if (err != -EINVAL)
+			goto out;
+		/* the branch fs refused splicing, copy by read/write */
+		AuDbg("splice failed, falling back\n");
+	}
+
 	err = -ENOMEM;
 	blksize = dst->f_dentry->d_sb->s_blocksize;
 	if (!blksize || PAGE_SIZE < blksize)
@@ -49,6 +49,9 @@ void au_cpup_attr_all(struct inode *inode, int force);
 #define au_fset_cpup(flags, name)	{ (flags) |= AuCpup_##name; }
 #define au_fclr_cpup(flags, name)	{ (flags) &= ~AuCpup_##name; }
 
+/* bytes spliced at once by au_copy_file() */
+#define AuCpup_SPLICE_CHUNK	(1 << 22)
+
 int au_copy_file(struct file *dst, struct file *src, loff_t len);
 int au_sio_cpup_single(struct dentry *dentry, aufs_bindex_t bdst,
 		       aufs_bindex_t bsrc, loff_t len, unsigned int flags,
@@ -184,8 +184,9 @@ int au_lkup_dentry(struct dentry *dentry, aufs_bindex_t bstart, mode_t type,
 		   struct nameidata *nd)
 {
 	int npositive, err;
-	aufs_bindex_t bindex, btail, bdiropq;
-	unsigned char isdir;
+	unsigned int nlc_seq;
+	aufs_bindex_t bindex, btail, bdiropq, nlc_bwh;
+	unsigned char isdir, use_nlc, nlc_hit;
 	struct qstr whname;
 	struct au_do_lookup_args args = {
 		.flags	= 0,
@@ -210,6 +211,17 @@ int au_lkup_dentry(struct dentry *dentry, aufs_bindex_t bstart, mode_t type,
 	if (!type)
 		au_fset_lkup(args.flags, ALLOW_NEG);
 
+	/*
+	 * a plain lookup of a new name. if it is known to be negative on all
+	 * branches, only the first branch is looked up to get its negative
+	 * h_dentry and the whiteout state is taken from the cache.
+	 */
+	nlc_hit = 0;
+	use_nlc = (!type && !inode && bstart == au_dbstart(parent));
+	if (use_nlc)
+		nlc_hit = au_nlc_test(parent->d_inode, name, &nlc_bwh,
+				      &nlc_seq);
+
 	npositive = 0;
 	btail = au_dbtaildir(parent);
 	for (bindex = bstart; bindex <= btail; bindex++) {
@@ -242,6 +254,11 @@ int au_lkup_dentry(struct dentry *dentry, aufs_bindex_t bstart, mode_t type,
 
 		if (au_dbwh(dentry) >= 0)
 			break;
+		if (nlc_hit && !(h_dentry && h_dentry->d_inode)) {
+			if (nlc_bwh >= 0)
+				au_set_dbwh(dentry, nlc_bwh);
+			break;
+		}
 		if (!h_dentry)
 			continue;
 		h_inode = h_dentry->d_inode;
@@ -263,7 +280,8 @@ int au_lkup_dentry(struct dentry *dentry, aufs_bindex_t bstart, mode_t type,
 	if (npositive) {
 		AuLabel(positive);
 		au_update_dbstart(dentry);
-	}
+	} else if (use_nlc && !nlc_hit && au_dbstart(dentry) >= 0)
+		au_nlc_add(parent->d_inode, name, au_dbwh(dentry), nlc_seq);
 	err = npositive;
 	if (unlikely(!au_opt_test(au_mntflags(dentry->d_sb), UDBA_NONE)
 		     && au_dbstart(dentry) < 0))
@@ -112,6 +112,59 @@ int au_vdir_fill_de(struct file *file, void *dirent, filldir_t filldir);
 /* ioctl.c */
 long aufs_ioctl_dir(struct file *file, unsigned int cmd, unsigned long arg);
 
+#ifdef CONFIG_AUFS_NLCACHE
+/* nlcache.c */
+#define AuNlc_NENT	16	/* must be a power of 2 */
+#define AuNlc_NAMELEN	39
+
+struct au_nlc_entry {
+	unsigned int	ne_hash;
+	aufs_bindex_t	ne_bwh;
+	unsigned char	ne_len;
+	char		ne_name[AuNlc_NAMELEN];
+};
+
+struct au_nlc {
+	spinlock_t		nc_spin;
+	unsigned int		nc_seq;
+	unsigned int		nc_sigen;
+	u64			nc_version;
+	unsigned long		nc_jiffy;
+	struct au_nlc_entry	nc_ent[AuNlc_NENT];
+};
+
+struct au_iinfo;
+int au_nlc_test(struct inode *dir, const struct qstr *name, aufs_bindex_t *bwh,
+		unsigned int *seq);
+void au_nlc_add(struct inode *dir, const struct qstr *name, aufs_bindex_t bwh,
+		unsigned int seq);
+void au_nlc_inval(struct inode *dir);
+void au_nlc_free(struct au_iinfo *iinfo);
+#else
+static inline int au_nlc_test(struct inode *dir, const struct qstr *name,
+			      aufs_bindex_t *bwh, unsigned int *seq)
+{
+	*seq = 0;
+	return 0;
+}
+
+static inline void au_nlc_add(struct inode *dir, const struct qstr *name,
+			      aufs_bindex_t bwh, unsigned int seq)
+{
+	/* empty */
+}
+
+static inline void au_nlc_inval(struct inode *dir)
+{
+	/* empty */
+}
+
+static inline void au_nlc_free(struct au_iinfo *iinfo)
+{
+	/* empty */
+}
+#endif
+
 #ifdef CONFIG_AUFS_RDU
 /* rdu.c */
 long au_rdu_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
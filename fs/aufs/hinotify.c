@@ -673,6 +673,9 @@ static void aufs_inotify(struct inotify_watch *watch, u32 wd __maybe_unused,
 		AuDebugOn(1);
 	}
 
+	/* drop the negative lookups now, postproc() runs later */
+	au_nlc_inval(dir);
+
 	if (wh)
 		h_child_inode = NULL;
 
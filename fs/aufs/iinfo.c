@@ -192,6 +192,9 @@ int au_iinfo_init(struct inode *inode)
 		iinfo->ii_bstart = -1;
 		iinfo->ii_bend = -1;
 		iinfo->ii_vdir = NULL;
+#ifdef CONFIG_AUFS_NLCACHE
+		iinfo->ii_nlc = NULL;
+#endif
 		return 0;
 	}
 	return -ENOMEM;
@@ -257,6 +260,7 @@ void au_iinfo_fin(struct inode *inode)
 
 	if (iinfo->ii_vdir)
 		au_vdir_free(iinfo->ii_vdir);
+	au_nlc_free(iinfo);
 
 	if (iinfo->ii_bstart >= 0) {
 		sb = inode->i_sb;
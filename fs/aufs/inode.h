@@ -51,6 +51,7 @@ struct au_hinode {
 };
 
 struct au_vdir;
+struct au_nlc;
 struct au_iinfo {
 	atomic_t		ii_generation;
 	struct super_block	*ii_hsb1;	/* no get/put */
@@ -60,6 +61,9 @@ struct au_iinfo {
 	__u32			ii_higen;
 	struct au_hinode	*ii_hinode;
 	struct au_vdir		*ii_vdir;
+#ifdef CONFIG_AUFS_NLCACHE
+	struct au_nlc		*ii_nlc;
+#endif
 };
 
 struct au_icntnr {
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2005-2009 Junjiro R. Okajima
+ *
+ * This program, aufs is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * negative lookup cache per directory
+ *
+ * remembers the names which were not found on any branch, so that the next
+ * lookup of them stops at the first branch instead of probing every branch
+ * and whiteout again.
+ * the cache is dropped when the aufs dir version changes (aufs itself added
+ * or removed an entry), when the branches are changed (sigen), when hinotify
+ * reports a change on a lower dir, or when it is older than rdcache.
+ * with udba=reval nobody tells us about the changes on the lower dirs, so it
+ * is not used.
+ */
+
+#include "aufs.h"
+
+static int au_nlc_usable(struct super_block *sb)
+{
+	return !au_opt_test(au_mntflags(sb), UDBA_REVAL);
+}
+
+static struct au_nlc_entry *au_nlc_slot(struct au_nlc *nlc,
+					 const struct qstr *name)
+{
+	return nlc->nc_ent + (name->hash & (AuNlc_NENT - 1));
+}
+
+/* the caller holds nc_spin */
+static void au_nlc_reset(struct au_nlc *nlc, struct inode *dir)
+{
+	memset(nlc->nc_ent, 0, sizeof(nlc->nc_ent));
+	nlc->nc_version = dir->i_version;
+	nlc->nc_sigen = au_sigen(dir->i_sb);
+	nlc->nc_jiffy = jiffies;
+}
+
+/* the caller holds nc_spin */
+static int au_nlc_valid(struct au_nlc *nlc, struct inode *dir)
+{
+	return nlc->nc_version == dir->i_version
+		&& nlc->nc_sigen == au_sigen(dir->i_sb)
+		&& !time_after(jiffies,
+			       nlc->nc_jiffy + au_sbi(dir->i_sb)->si_rdcache);
+}
+
+/*
+ * returns non-zero if @name is known to be negative on every branch of @dir,
+ * and sets the branch index where the whiteout was found to @bwh.
+ * otherwise sets @seq which should be passed to au_nlc_add() later.
+ */
+int au_nlc_test(struct inode *dir, const struct qstr *name, aufs_bindex_t *bwh,
+		unsigned int *seq)
+{
+	int found;
+	struct au_nlc *nlc;
+	struct au_nlc_entry *ent;
+	struct au_iinfo *iinfo;
+
+	*seq = 0;
+	if (!au_nlc_usable(dir->i_sb) || name->len > AuNlc_NAMELEN)
+		return 0;
+
+	iinfo = au_ii(dir);
+	nlc = iinfo->ii_nlc;
+	if (!nlc) {
+		nlc = kzalloc(sizeof(*nlc), GFP_NOFS);
+		if (unlikely(!nlc))
+			return 0;
+		spin_lock_init(&nlc->nc_spin);
+		spin_lock(&nlc->nc_spin);
+		au_nlc_reset(nlc, dir);
+		spin_unlock(&nlc->nc_spin);
+		if (cmpxchg(&iinfo->ii_nlc, NULL, nlc)) {
+			kfree(nlc);
+			nlc = iinfo->ii_nlc;
+		}
+	}
+
+	found = 0;
+	spin_lock(&nlc->nc_spin);
+	if (!au_nlc_valid(nlc, dir))
+		au_nlc_reset(nlc, dir);
+	ent = au_nlc_slot(nlc, name);
+	if (ent->ne_len == name->len
+	    && ent->ne_hash == name->hash
+	    && !memcmp(ent->ne_name, name->name, name->len)) {
+		found = 1;
+		*bwh = ent->ne_bwh;
+	} else
+		*seq = nlc->nc_seq;
+	spin_unlock(&nlc->nc_spin);
+
+	return found;
+}
+
+/*
+ * remember that @name was not found on any branch of @dir.
+ * nothing is recorded when the lower dirs were changed since au_nlc_test().
+ */
+void au_nlc_add(struct inode *dir, const struct qstr *name, aufs_bindex_t bwh,
+		unsigned int seq)
+{
+	struct au_nlc *nlc;
+	struct au_nlc_entry *ent;
+
+	if (!au_nlc_usable(dir->i_sb) || name->len > AuNlc_NAMELEN)
+		return;
+
+	nlc = au_ii(dir)->ii_nlc;
+	if (!nlc)
+		return;
+
+	spin_lock(&nlc->nc_spin);
+	if (nlc->nc_seq == seq && au_nlc_valid(nlc, dir)) {
+		ent = au_nlc_slot(nlc, name);
+		ent->ne_hash = name->hash;
+		ent->ne_bwh = bwh;
+		ent->ne_len = name->len;
+		memcpy(ent->ne_name, name->name, name->len);
+	}
+	spin_unlock(&nlc->nc_spin);
+}
+
+/* called by hinotify, no aufs lock is held */
+void au_nlc_inval(struct inode *dir)
+{
+	struct au_iinfo *iinfo;
+	struct au_nlc *nlc;
+
+	iinfo = au_ii(dir);
+	if (!iinfo)
+		return;
+
+	nlc = iinfo->ii_nlc;
+	if (!nlc)
+		return;
+
+	spin_lock(&nlc->nc_spin);
+	nlc->nc_seq++;
+	memset(nlc->nc_ent, 0, sizeof(nlc->nc_ent));
+	spin_unlock(&nlc->nc_spin);
+}
+
+void au_nlc_free(struct au_iinfo *iinfo)
+{
+	kfree(iinfo->ii_nlc);
+	iinfo->ii_nlc = NULL;
+}
@@ -491,6 +491,42 @@ long vfsub_splice_from(struct pipe_inode_info *pipe, struct file *out,
 	return err;
 }
 
+static int vfsub_splice_direct_actor(struct pipe_inode_info *pipe,
+				     struct splice_desc *sd)
+{
+	struct file *out = sd->u.file;
+
+	return do_splice_from(pipe, out, &out->f_pos, sd->total_len,
+			      sd->flags);
+}
+
+/*
+ * cf. splice.c:do_splice_direct(), which is not exported.
+ * the output is written at out->f_pos.
+ */
+long vfsub_splice_direct(struct file *in, loff_t *ppos, struct file *out,
+			 size_t len, unsigned int flags)
+{
+	long err;
+	struct splice_desc sd = {
+		.len		= len,
+		.total_len	= len,
+		.flags		= flags,
+		.pos		= *ppos,
+		.u.file		= out
+	};
+
+	lockdep_off();
+	err = splice_direct_to_actor(in, &sd, vfsub_splice_direct_actor);
+	lockdep_on();
+	if (err > 0) {
+		*ppos = sd.pos;
+		vfsub_update_h_iattr(&in->f_path, /*did*/NULL); /*ignore*/
+		vfsub_update_h_iattr(&out->f_path, /*did*/NULL); /*ignore*/
+	}
+	return err;
+}
+
 /* cf. open.c:do_sys_truncate() and do_sys_ftruncate() */
 int vfsub_trunc(struct path *h_path, loff_t length, unsigned int attr,
 		struct file *h_file)
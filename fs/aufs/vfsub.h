@@ -117,6 +117,8 @@ long vfsub_splice_to(struct file *in, loff_t *ppos,
 		     unsigned int flags);
 long vfsub_splice_from(struct pipe_inode_info *pipe, struct file *out,
 		       loff_t *ppos, size_t len, unsigned int flags);
+long vfsub_splice_direct(struct file *in, loff_t *ppos, struct file *out,
+			 size_t len, unsigned int flags);
 int vfsub_trunc(struct path *h_path, loff_t length, unsigned int attr,
 		struct file *h_file);
 
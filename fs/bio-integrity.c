@@ -740,7 +740,7 @@ void __init bio_integrity_init_slab(void)
 
 static int __init integrity_init(void)
 {
-	kintegrityd_wq = create_workqueue("kintegrityd");
+	kintegrityd_wq = create_reclaim_workqueue("kintegrityd");
 
 	if (!kintegrityd_wq)
 		panic("Failed to create kintegrityd\n");
@@ -23,6 +23,8 @@
 #include <linux/inotify.h>
 #include <linux/mount.h>
 #include <linux/async.h>
+#include <linux/ccache.h>
+#include <linux/workingset.h>
 
 /*
  * This is needed for the following functions:
@@ -209,6 +211,8 @@ static struct inode *alloc_inode(struct super_block *sb)
 void destroy_inode(struct inode *inode) 
 {
 	BUG_ON(inode_has_buffers(inode));
+	ccache_invalidate_mapping(&inode->i_data);
+	workingset_invalidate_mapping(&inode->i_data);
 	security_inode_free(inode);
 	if (inode->i_sb->s_op->destroy_inode)
 		inode->i_sb->s_op->destroy_inode(inode);
@@ -230,6 +234,14 @@ void inode_init_once(struct inode *inode)
 	INIT_LIST_HEAD(&inode->i_dentry);
 	INIT_LIST_HEAD(&inode->i_devices);
 	INIT_RADIX_TREE(&inode->i_data.page_tree, GFP_ATOMIC);
+#ifdef CONFIG_CCACHE
+	INIT_RADIX_TREE(&inode->i_data.ccache_tree, GFP_ATOMIC);
+#endif
+#ifdef CONFIG_WORKINGSET
+	/* filled from reclaim, which must not dip into the reserves */
+	INIT_RADIX_TREE(&inode->i_data.shadow_tree,
+			GFP_NOWAIT | __GFP_NOMEMALLOC | __GFP_NOWARN);
+#endif
 	spin_lock_init(&inode->i_data.tree_lock);
 	spin_lock_init(&inode->i_data.i_mmap_lock);
 	INIT_LIST_HEAD(&inode->i_data.private_list);
@@ -2875,7 +2875,7 @@ int journal_init(struct super_block *p_s_sb, const char *j_dev_name,
 
 	reiserfs_mounted_fs_count++;
 	if (reiserfs_mounted_fs_count <= 1)
-		commit_wq = create_workqueue("reiserfs");
+		commit_wq = create_reclaim_workqueue("reiserfs");
 
 	INIT_DELAYED_WORK(&journal->j_work, flush_async_commits);
 	journal->j_work_sb = p_s_sb;
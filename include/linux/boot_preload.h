@@ -0,0 +1,32 @@
+#ifndef _LINUX_BOOT_PRELOAD_H
+#define _LINUX_BOOT_PRELOAD_H
+/*
+ * Boot time page cache preloading: the ranges of files read in during one
+ * boot are recorded, and read in ahead of time on the next one.
+ */
+
+#include <linux/types.h>
+#include <linux/compiler.h>
+
+struct file;
+
+#ifdef CONFIG_BOOT_PRELOAD
+extern int boot_preload_recording;
+
+void __boot_preload_record(struct file *filp, pgoff_t start, unsigned long nr);
+
+/* @nr pages from @start of @filp had to be read from disk */
+static inline void boot_preload_record(struct file *filp, pgoff_t start,
+				       unsigned long nr)
+{
+	if (unlikely(boot_preload_recording) && filp)
+		__boot_preload_record(filp, start, nr);
+}
+#else
+static inline void boot_preload_record(struct file *filp, pgoff_t start,
+				       unsigned long nr)
+{
+}
+#endif
+
+#endif /* _LINUX_BOOT_PRELOAD_H */
@@ -0,0 +1,83 @@
+#ifndef _LINUX_CCACHE_H
+#define _LINUX_CCACHE_H
+/*
+ * Compressed cache for clean page cache pages: pages dropped by vmscan are
+ * kept LZO-compressed in memory and put back on the next page cache miss,
+ * instead of being read again from the device.
+ */
+
+#include <linux/errno.h>
+#include <linux/fs.h>
+#include <linux/mm_types.h>
+#include <linux/radix-tree.h>
+
+#ifdef CONFIG_CCACHE
+extern unsigned long ccache_max_pages;
+
+int ccache_put(struct address_space *mapping, struct page *page);
+void __ccache_get(struct address_space *mapping, struct page *page);
+void __ccache_invalidate_range(struct address_space *mapping,
+			       pgoff_t start, pgoff_t end);
+
+static inline int mapping_has_ccache(struct address_space *mapping)
+{
+	return mapping->ccache_tree.rnode != NULL;
+}
+
+/*
+ * ccache_get - fill a page just added to the page cache
+ *
+ * If a compressed copy of @page is held, it is decompressed into the page,
+ * which is then marked uptodate, and the copy is dropped.  The page cache
+ * and the compressed cache never hold the same page at the same time.
+ */
+static inline void ccache_get(struct address_space *mapping, struct page *page)
+{
+	if (mapping_has_ccache(mapping))
+		__ccache_get(mapping, page);
+}
+
+static inline void ccache_invalidate_range(struct address_space *mapping,
+					   pgoff_t start, pgoff_t end)
+{
+	if (mapping_has_ccache(mapping))
+		__ccache_invalidate_range(mapping, start, end);
+}
+
+static inline void ccache_invalidate_page(struct address_space *mapping,
+					  pgoff_t index)
+{
+	ccache_invalidate_range(mapping, index, index);
+}
+
+static inline void ccache_invalidate_mapping(struct address_space *mapping)
+{
+	ccache_invalidate_range(mapping, 0, ~0UL);
+}
+#else  /* !CONFIG_CCACHE */
+
+static inline int ccache_put(struct address_space *mapping, struct page *page)
+{
+	return -ENOSYS;
+}
+
+static inline void ccache_get(struct address_space *mapping, struct page *page)
+{
+}
+
+static inline void ccache_invalidate_range(struct address_space *mapping,
+					   pgoff_t start, pgoff_t end)
+{
+}
+
+static inline void ccache_invalidate_page(struct address_space *mapping,
+					  pgoff_t index)
+{
+}
+
+static inline void ccache_invalidate_mapping(struct address_space *mapping)
+{
+}
+#endif /* !CONFIG_CCACHE */
+
+#endif /* _LINUX_CCACHE_H */
@@ -0,0 +1,24 @@
+#ifndef _LINUX_COMPACTION_H
+#define _LINUX_COMPACTION_H
+/*
+ * Memory compaction: movable pages are migrated out of the start of a zone
+ * into free pages at its end, so that high-order free blocks form again.
+ */
+
+#include <linux/sysctl.h>
+
+#ifdef CONFIG_COMPACTION
+extern int sysctl_compact_memory;
+extern int sysctl_compaction_handler(struct ctl_table *table, int write,
+			struct file *file, void __user *buffer,
+			size_t *length, loff_t *ppos);
+extern int sysctl_extfrag_threshold;
+
+extern void wakeup_kcompactd(int order);
+#else
+static inline void wakeup_kcompactd(int order)
+{
+}
+#endif
+
+#endif /* _LINUX_COMPACTION_H */
@@ -21,6 +21,7 @@
 #include <linux/workqueue.h>
 #include <linux/cpumask.h>
 #include <asm/div64.h>
+#include <asm/cputime.h>
 
 #define CPUFREQ_NAME_LEN 16
 
@@ -48,6 +49,17 @@ static inline int cpufreq_unregister_notifier(struct notifier_block *nb,
 }
 #endif		/* CONFIG_CPU_FREQ */
 
+struct task_struct;
+
+#ifdef CONFIG_CPU_FREQ_UID_STAT
+void cpufreq_account_uid_time(struct task_struct *p, cputime_t cputime);
+#else
+static inline void cpufreq_account_uid_time(struct task_struct *p,
+					    cputime_t cputime)
+{
+}
+#endif
+
 /* if (cpufreq_driver->target) exists, the ->governor decides what frequency
  * within the limits is used. If (cpufreq_driver->setpolicy> exists, these
  * two generic policies are available:
@@ -563,6 +563,13 @@ struct address_space {
 	spinlock_t		private_lock;	/* for use by the address_space */
 	struct list_head	private_list;	/* ditto */
 	struct address_space	*assoc_mapping;	/* ditto */
+#ifdef CONFIG_CCACHE
+	struct radix_tree_root	ccache_tree;	/* compressed copies of evicted pages */
+#endif
+#ifdef CONFIG_WORKINGSET
+	struct radix_tree_root	shadow_tree;	/* eviction info of evicted pages */
+	unsigned long		nrshadows;	/* under tree_lock */
+#endif
 } __attribute__((aligned(sizeof(long))));
 	/*
 	 * On most architectures that alignment is already the case; but
@@ -821,6 +828,9 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	int mmap_miss;			/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+#ifdef CONFIG_READAHEAD_HISTORY
+	unsigned int history_replayed;	/* readahead history was replayed */
+#endif
 };
 
 /*
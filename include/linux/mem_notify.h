@@ -0,0 +1,26 @@
+#ifndef _LINUX_MEM_NOTIFY_H
+#define _LINUX_MEM_NOTIFY_H
+/*
+ * Memory pressure notification: /dev/mem_notify becomes readable when page
+ * reclaim gets hard, so that userspace can drop caches before the
+ * lowmemorykiller has to kill something.
+ */
+
+enum mem_notify_level {
+	MEM_NOTIFY_LOW,		/* reclaim is running */
+	MEM_NOTIFY_MEDIUM,	/* most of the scanned pages cannot be freed */
+	MEM_NOTIFY_CRITICAL,	/* reclaim is about to fail */
+	NR_MEM_NOTIFY_LEVELS
+};
+
+#ifdef CONFIG_MEM_NOTIFY
+void mem_notify_vmscan(int priority, unsigned long scanned,
+		       unsigned long reclaimed);
+#else
+static inline void mem_notify_vmscan(int priority, unsigned long scanned,
+				     unsigned long reclaimed)
+{
+}
+#endif
+
+#endif /* _LINUX_MEM_NOTIFY_H */
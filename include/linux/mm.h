@@ -104,6 +104,7 @@ extern unsigned int kobjsize(const void *objp);
 #define VM_CAN_NONLINEAR 0x08000000	/* Has ->fault & does nonlinear pages */
 #define VM_MIXEDMAP	0x10000000	/* Can contain "struct page" and pure PFN pages */
 #define VM_SAO		0x20000000	/* Strong Access Ordering (powerpc) */
+#define VM_MERGEABLE	0x80000000	/* KSM may merge identical pages */
 
 #ifndef VM_STACK_DEFAULT_FLAGS		/* arch can override this */
 #define VM_STACK_DEFAULT_FLAGS VM_DATA_DEFAULT_FLAGS
@@ -642,6 +643,8 @@ void page_address_init(void);
  * refers to user virtual address space into which the page is mapped.
  */
 #define PAGE_MAPPING_ANON	1
+#define PAGE_MAPPING_KSM	2
+#define PAGE_MAPPING_FLAGS	(PAGE_MAPPING_ANON | PAGE_MAPPING_KSM)
 
 extern struct address_space swapper_space;
 static inline struct address_space *page_mapping(struct page *page)
@@ -1209,6 +1212,25 @@ void page_cache_async_readahead(struct address_space *mapping,
 
 unsigned long max_sane_readahead(unsigned long nr);
 
+#ifdef CONFIG_READAHEAD_HISTORY
+/* kbytes read around a fault in a file that is accessed at random */
+#define VM_CLUSTER_READAHEAD	32
+
+void page_cache_fault_history(struct address_space *mapping,
+			      struct file_ra_state *ra,
+			      struct file *filp,
+			      pgoff_t offset);
+#else
+#define VM_CLUSTER_READAHEAD	0
+
+static inline void page_cache_fault_history(struct address_space *mapping,
+					    struct file_ra_state *ra,
+					    struct file *filp,
+					    pgoff_t offset)
+{
+}
+#endif
+
 /* Do stack extension */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 #ifdef CONFIG_IA64
@@ -20,6 +20,7 @@
 #define AT_VECTOR_SIZE (2*(AT_VECTOR_SIZE_ARCH + AT_VECTOR_SIZE_BASE + 1))
 
 struct address_space;
+struct futex_hash_bucket;
 
 #define USE_SPLIT_PTLOCKS	(NR_CPUS >= CONFIG_SPLIT_PTLOCK_CPUS)
 
@@ -274,6 +275,10 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	/* hash table of the process private futexes, see kernel/futex.c */
+	struct futex_hash_bucket *futex_hash;
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
@@ -107,6 +107,10 @@ enum zone_stat_item {
 	NR_VMSCAN_WRITE,
 	/* Second 128 byte cacheline */
 	NR_WRITEBACK_TEMP,	/* Writeback using temporary buffers */
+#ifdef CONFIG_CCACHE
+	NR_CCACHE_PAGES,	/* evicted file pages held compressed */
+	NR_CCACHE_POOL,		/* pages used to hold them */
+#endif
 #ifdef CONFIG_NUMA
 	NUMA_HIT,		/* allocated in intended node */
 	NUMA_MISS,		/* allocated in non intended node */
@@ -166,11 +170,19 @@ static inline int is_unevictable_lru(enum lru_list l)
 #endif
 }
 
+/*
+ * Blocks of order 1 to PCP_HIGH_ORDERS are cached per cpu as well, on
+ * hlist[order - 1], at most batch >> order of them.
+ */
+#define PCP_HIGH_ORDERS		PAGE_ALLOC_COSTLY_ORDER
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
 	int batch;		/* chunk size for buddy add/remove */
 	struct list_head list;	/* the list of pages */
+	int hcount[PCP_HIGH_ORDERS];		/* blocks on each hlist */
+	struct list_head hlist[PCP_HIGH_ORDERS];/* higher order blocks */
 };
 
 struct per_cpu_pageset {
@@ -329,6 +341,10 @@ struct zone {
 	} lru[NR_LRU_LISTS];
 
 	struct zone_reclaim_stat reclaim_stat;
+#ifdef CONFIG_WORKINGSET
+	/* pages evicted or activated from the inactive file list */
+	atomic_long_t		inactive_age;
+#endif
 
 	unsigned long		pages_scanned;	   /* since last reclaim */
 	unsigned long		flags;		   /* zone flags, see below */
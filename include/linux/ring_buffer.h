@@ -132,6 +132,8 @@ void *ring_buffer_alloc_read_page(struct ring_buffer *buffer);
 void ring_buffer_free_read_page(struct ring_buffer *buffer, void *data);
 int ring_buffer_read_page(struct ring_buffer *buffer,
 			  void **data_page, int cpu, int full);
+struct ring_buffer_event *
+ring_buffer_page_event(void *data_page, unsigned *offset);
 
 enum ring_buffer_flags {
 	RB_FL_OVERWRITE		= 1 << 0,
@@ -426,6 +426,12 @@ extern int get_dumpable(struct mm_struct *mm);
 # define MMF_DUMP_MASK_DEFAULT_ELF	0
 #endif
 
+#define MMF_VM_MERGEABLE	16	/* KSM may merge identical pages */
+
+/* the bits a new mm takes over from its parent */
+#define MMF_DUMPABLE_MASK	((1 << MMF_DUMPABLE_BITS) - 1)
+#define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
+
 struct sighand_struct {
 	atomic_t		count;
 	struct k_sigaction	action[_NSIG];
@@ -675,6 +681,24 @@ struct backing_dev_info;
 struct reclaim_state;
 
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
+#ifdef CONFIG_SCHEDLAT
+/*
+ * Histograms of the time tasks wait on a runqueue before they run.  Bucket
+ * 0 counts waits below 1024ns, bucket n > 0 those from 512ns << n to twice
+ * that, and the last one also all longer waits.
+ */
+#define SCHEDLAT_BUCKETS	24
+
+struct sched_lat_hist {
+	unsigned int wakeup[SCHEDLAT_BUCKETS];	/* from wakeup to run */
+	unsigned int wait[SCHEDLAT_BUCKETS];	/* any wait to run */
+};
+
+struct seq_file;
+extern void sched_lat_hist_show(struct seq_file *m,
+				const struct sched_lat_hist *hist);
+#endif
+
 struct sched_info {
 	/* cumulative counters */
 	unsigned long pcount;	      /* # of times run on this cpu */
@@ -687,6 +711,12 @@ struct sched_info {
 	/* BKL stats */
 	unsigned int bkl_count;
 #endif
+#ifdef CONFIG_SCHEDLAT
+	/* wait before being moved to another runqueue, if queued again */
+	unsigned long long lat_delay;
+	/* the wait started with a wakeup */
+	int lat_wakeup;
+#endif
 };
 #endif /* defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT) */
 
@@ -1149,6 +1179,9 @@ struct task_struct {
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 	struct sched_info sched_info;
 #endif
+#ifdef CONFIG_SCHEDLAT
+	struct sched_lat_hist sched_lat;
+#endif
 
 	struct list_head tasks;
 
@@ -1320,6 +1353,9 @@ struct task_struct {
 /* journalling filesystem info */
 	void *journal_info;
 
+/* workqueue worker, if PF_WQ_WORKER */
+	void *wq_worker;
+
 /* stacked block device info */
 	struct bio *bio_list, **bio_tail;
 
@@ -1601,6 +1637,7 @@ extern int task_free_unregister(struct notifier_block *n);
 #define PF_EXITING	0x00000004	/* getting shut down */
 #define PF_EXITPIDONE	0x00000008	/* pi exit done on shut down */
 #define PF_VCPU		0x00000010	/* I'm a virtual CPU */
+#define PF_WQ_WORKER	0x00000020	/* I'm a workqueue worker */
 #define PF_FORKNOEXEC	0x00000040	/* forked but didn't exec */
 #define PF_SUPERPRIV	0x00000100	/* used super-user privileges */
 #define PF_DUMPCORE	0x00000200	/* dumped core */
@@ -2281,6 +2318,9 @@ extern void sched_move_task(struct task_struct *tsk);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 extern unsigned long sched_group_shares(struct task_group *tg);
+extern int sched_group_set_latency(struct task_group *tg,
+				   unsigned int latency_pct);
+extern unsigned int sched_group_latency(struct task_group *tg);
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 extern int sched_group_set_rt_runtime(struct task_group *tg,
@@ -16,6 +16,8 @@ struct timer_list {
 	unsigned long data;
 
 	struct tvec_base *base;
+
+	int slack;
 #ifdef CONFIG_TIMER_STATS
 	void *start_site;
 	char start_comm[16];
@@ -31,6 +33,7 @@ extern struct tvec_base boot_tvec_bases;
 		.expires = (_expires),				\
 		.data = (_data),				\
 		.base = &boot_tvec_bases,			\
+		.slack = -1,					\
 	}
 
 #define DEFINE_TIMER(_name, _function, _expires, _data)		\
@@ -89,6 +92,8 @@ extern int del_timer(struct timer_list * timer);
 extern int __mod_timer(struct timer_list *timer, unsigned long expires);
 extern int mod_timer(struct timer_list *timer, unsigned long expires);
 
+extern void set_timer_slack(struct timer_list *timer, int slack_hz);
+
 /*
  * The jiffies value which is added to now, when there is no timer
  * in the timer wheel:
@@ -50,6 +50,22 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		UNEVICTABLE_PGCLEARED,	/* on COW, page truncate */
 		UNEVICTABLE_PGSTRANDED,	/* unable to isolate on unlock */
 		UNEVICTABLE_MLOCKFREED,
+#endif
+#ifdef CONFIG_CCACHE
+		CCACHE_STORE,		/* evicted page stored compressed */
+		CCACHE_REJECT,		/* not stored: busy, incompressible, no memory */
+		CCACHE_HIT,		/* page cache miss served from ccache */
+		CCACHE_INVALIDATE,	/* dropped by truncate or direct I/O */
+		CCACHE_EVICT,		/* dropped to keep the pool bounded */
+#endif
+#ifdef CONFIG_WORKINGSET
+		WORKINGSET_REFAULT,	/* evicted file page faulted in again */
+		WORKINGSET_ACTIVATE,	/* ... soon enough to be activated */
+#endif
+#ifdef CONFIG_COMPACTION
+		COMPACTBLOCKS,		/* blocks of pages isolated for migration */
+		COMPACTPAGES,		/* pages moved by compaction */
+		COMPACTPAGEFAILED,	/* pages compaction could not move */
 #endif
 		NR_VM_EVENT_ITEMS
 };
@@ -0,0 +1,73 @@
+#ifndef _LINUX_WORKINGSET_H
+#define _LINUX_WORKINGSET_H
+/*
+ * Refault detection: a file page evicted by page reclaim leaves a shadow
+ * entry behind, from which the next fault on it can tell how long it was
+ * out, and whether it would have stayed in memory with a larger active list.
+ */
+
+#include <linux/fs.h>
+#include <linux/mm_types.h>
+
+#ifdef CONFIG_WORKINGSET
+void workingset_eviction(struct address_space *mapping, struct page *page);
+void *__workingset_take_shadow(struct address_space *mapping, pgoff_t index);
+int workingset_refault(void *shadow);
+void workingset_activation(struct page *page);
+void __workingset_invalidate_range(struct address_space *mapping,
+				   pgoff_t start, pgoff_t end);
+
+/*
+ * workingset_take_shadow - remove the shadow entry of a page being added
+ *
+ * Called under the mapping's tree_lock.  Returns the shadow entry, to be
+ * passed to workingset_refault(), or NULL if there was none.
+ */
+static inline void *workingset_take_shadow(struct address_space *mapping,
+					   pgoff_t index)
+{
+	if (!mapping->nrshadows)
+		return NULL;
+	return __workingset_take_shadow(mapping, index);
+}
+
+static inline void workingset_invalidate_range(struct address_space *mapping,
+					       pgoff_t start, pgoff_t end)
+{
+	if (mapping->nrshadows)
+		__workingset_invalidate_range(mapping, start, end);
+}
+#else  /* !CONFIG_WORKINGSET */
+
+static inline void workingset_eviction(struct address_space *mapping,
+				       struct page *page)
+{
+}
+
+static inline void *workingset_take_shadow(struct address_space *mapping,
+					   pgoff_t index)
+{
+	return NULL;
+}
+
+static inline int workingset_refault(void *shadow)
+{
+	return 0;
+}
+
+static inline void workingset_activation(struct page *page)
+{
+}
+
+static inline void workingset_invalidate_range(struct address_space *mapping,
+					       pgoff_t start, pgoff_t end)
+{
+}
+#endif /* !CONFIG_WORKINGSET */
+
+static inline void workingset_invalidate_mapping(struct address_space *mapping)
+{
+	workingset_invalidate_range(mapping, 0, ~0UL);
+}
+
+#endif /* _LINUX_WORKINGSET_H */
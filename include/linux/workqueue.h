@@ -161,11 +161,11 @@ struct execute_work {
 
 extern struct workqueue_struct *
 __create_workqueue_key(const char *name, int singlethread,
-		       int freezeable, int rt, struct lock_class_key *key,
-		       const char *lock_name);
+		       int freezeable, int rt, int reclaim,
+		       struct lock_class_key *key, const char *lock_name);
 
 #ifdef CONFIG_LOCKDEP
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
+#define __create_workqueue(name, singlethread, freezeable, rt, reclaim) \
 ({								\
 	static struct lock_class_key __key;			\
 	const char *__lock_name;				\
@@ -176,19 +176,21 @@ __create_workqueue_key(const char *name, int singlethread,
 		__lock_name = #name;				\
 								\
 	__create_workqueue_key((name), (singlethread),		\
-			       (freezeable), (rt), &__key,	\
-			       __lock_name);			\
+			       (freezeable), (rt), (reclaim),	\
+			       &__key, __lock_name);		\
 })
 #else
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
+#define __create_workqueue(name, singlethread, freezeable, rt, reclaim) \
 	__create_workqueue_key((name), (singlethread), (freezeable), (rt), \
-			       NULL, NULL)
+			       (reclaim), NULL, NULL)
 #endif
 
-#define create_workqueue(name) __create_workqueue((name), 0, 0, 0)
-#define create_rt_workqueue(name) __create_workqueue((name), 0, 0, 1)
-#define create_freezeable_workqueue(name) __create_workqueue((name), 1, 1, 0)
-#define create_singlethread_workqueue(name) __create_workqueue((name), 1, 0, 0)
+#define create_workqueue(name) __create_workqueue((name), 0, 0, 0, 0)
+#define create_rt_workqueue(name) __create_workqueue((name), 0, 0, 1, 0)
+#define create_freezeable_workqueue(name) __create_workqueue((name), 1, 1, 0, 0)
+#define create_singlethread_workqueue(name) __create_workqueue((name), 1, 0, 0, 0)
+/* for work which memory reclaim may wait on, e.g. to complete I/O */
+#define create_reclaim_workqueue(name) __create_workqueue((name), 0, 0, 0, 1)
 
 extern void destroy_workqueue(struct workqueue_struct *wq);
 
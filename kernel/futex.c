@@ -54,6 +54,8 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/pid.h>
+#include <linux/bootmem.h>
+#include <linux/log2.h>
 #include <linux/nsproxy.h>
 
 #include <asm/futex.h>
@@ -62,7 +64,22 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
+/*
+ * Buckets of the global futex hash per possible cpu.  The table is
+ * allocated at boot, so that futexes of many processes hashing to it
+ * don't all contend on a fixed 256 bucket locks on larger machines.
+ */
+#define FUTEX_HASH_PER_CPU (CONFIG_BASE_SMALL ? 16 : 256)
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+/*
+ * Process private futexes hash to a table of their own mm instead,
+ * allocated on first use.
+ */
+#define FUTEX_PRIVATE_HASHBITS (CONFIG_BASE_SMALL ? 4 : 6)
+/* the mm could not get a table and uses the global one for good */
+#define FUTEX_PRIVATE_HASH_NONE ((struct futex_hash_bucket *)-1L)
+#endif
 
 /*
  * Priority Inheritance state:
@@ -121,7 +138,62 @@ struct futex_hash_bucket {
 	struct plist_head chain;
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+static struct futex_hash_bucket *futex_queues __read_mostly;
+static unsigned int futex_hashmask __read_mostly;
+
+static void futex_hash_init(struct futex_hash_bucket *hb, unsigned long nr)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr; i++) {
+		plist_head_init(&hb[i].chain, &hb[i].lock);
+		spin_lock_init(&hb[i].lock);
+	}
+}
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+/*
+ * Return the private futex table of @mm, allocating it if this is the
+ * first private futex of the process.  Once set, mm->futex_hash never
+ * changes until the mm is freed: a waiter and its waker must always
+ * find the same bucket.  Should the allocation fail, the mm is marked
+ * to keep using the global table instead.
+ *
+ * Only called from process context, except for exit_pi_state_list(),
+ * which hashes a key that has been queued before and so has its table.
+ */
+static struct futex_hash_bucket *futex_private_hash(struct mm_struct *mm)
+{
+	struct futex_hash_bucket *hash, *old;
+
+	hash = mm->futex_hash;
+	if (likely(hash)) {
+		smp_read_barrier_depends();
+		return hash;
+	}
+
+	hash = kmalloc(sizeof(*hash) << FUTEX_PRIVATE_HASHBITS, GFP_KERNEL);
+	if (hash)
+		futex_hash_init(hash, 1 << FUTEX_PRIVATE_HASHBITS);
+	else
+		hash = FUTEX_PRIVATE_HASH_NONE;
+
+	/* cmpxchg() orders the initialisation before the table is seen */
+	old = cmpxchg(&mm->futex_hash, NULL, hash);
+	if (old) {
+		if (hash != FUTEX_PRIVATE_HASH_NONE)
+			kfree(hash);
+		hash = old;
+	}
+	return hash;
+}
+
+void futex_hash_free(struct mm_struct *mm)
+{
+	if (mm->futex_hash != FUTEX_PRIVATE_HASH_NONE)
+		kfree(mm->futex_hash);
+}
+#endif
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
@@ -131,7 +203,19 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	/* Private keys only ever match keys of the same mm. */
+	if (!(key->both.offset & (FUT_OFF_INODE|FUT_OFF_MMSHARED)) &&
+	    key->private.mm) {
+		struct futex_hash_bucket *hb;
+
+		hb = futex_private_hash(key->private.mm);
+		if (hb != FUTEX_PRIVATE_HASH_NONE)
+			return &hb[hash & ((1 << FUTEX_PRIVATE_HASHBITS) - 1)];
+	}
+#endif
+	return &futex_queues[hash & futex_hashmask];
 }
 
 /*
@@ -2049,7 +2133,7 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 static int __init futex_init(void)
 {
 	u32 curval;
-	int i;
+	unsigned int hashshift;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2065,10 +2149,12 @@ static int __init futex_init(void)
 	if (curval == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
-		plist_head_init(&futex_queues[i].chain, &futex_queues[i].lock);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	futex_queues = alloc_large_system_hash("futex",
+			sizeof(struct futex_hash_bucket),
+			roundup_pow_of_two(FUTEX_HASH_PER_CPU *
+					   num_possible_cpus()),
+			0, 0, &hashshift, &futex_hashmask, 0);
+	futex_hash_init(futex_queues, 1UL << hashshift);
 
 	return 0;
 }
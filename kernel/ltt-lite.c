@@ -240,6 +240,7 @@
 #include <linux/mm.h>
 #include <linux/syscalls.h>
 #include <linux/ioport.h>
+#include <linux/ring_buffer.h>
 #include <mach/system.h>
 
 /* debug printk macro */
@@ -796,6 +797,207 @@ static int process_name_table_init(void)
 	return 0;
 }
 
+#ifdef CONFIG_LTT_LITE_RING_BUFFER
+/*
+ * per-CPU recording
+ *
+ * Events are reserved on the ring buffer of the local cpu, which only
+ * disables preemption, so commit_log() neither turns interrupts off nor
+ * shares one buffer between cpus. The lttliter work thread swaps full
+ * pages out of the ring buffer and hands the records of a page to one
+ * writev(), so they are not copied into another buffer on the way.
+ * The ring buffer is kept across stop and start, commit_log() may still
+ * be running on another cpu when logging is stopped.
+ */
+#define LTT_LITE_RB_SIZE (PAGE_SIZE << LTT_LITE_PAGE_ORDER)
+#define LTT_LITE_RB_DRAIN_INTERVAL (HZ / 5)
+#define LTT_LITE_RB_IOV 64
+
+static struct ring_buffer *ltt_lite_rb;
+static void *ltt_lite_rb_page;
+static bool ltt_lite_rb_active;
+static unsigned long ltt_lite_rb_file_pos;
+static struct iovec ltt_lite_rb_iov[LTT_LITE_RB_IOV];
+static DEFINE_PER_CPU(unsigned long [LTT_LITE_EV_LAST], ltt_lite_rb_lost);
+
+static void wq_rb_drain(struct work_struct *ignore);
+static DECLARE_DELAYED_WORK(wq_rb_drain_work, wq_rb_drain);
+
+static void ltt_lite_rb_commit(void *addr, int size, unsigned short type)
+{
+	struct record_header_t *header = addr;
+	struct ring_buffer_event *event;
+	unsigned long flags;
+
+	event = ring_buffer_lock_reserve(ltt_lite_rb, size, &flags);
+	if (unlikely(!event)) {
+		/* rare, an interrupt may lose one count here otherwise */
+		local_irq_save(flags);
+		__get_cpu_var(ltt_lite_rb_lost)[type]++;
+		local_irq_restore(flags);
+		return;
+	}
+	get_time_stamp((struct timeval *) &header->timestamp_sec);
+	memcpy(ring_buffer_event_data(event), addr, size);
+	ring_buffer_unlock_commit(ltt_lite_rb, event, flags);
+}
+
+/* write the first @nr entries of ltt_lite_rb_iov, @len bytes in total */
+static void ltt_lite_rb_writev(int nr, size_t len)
+{
+	long result;
+
+	if (ltt_lite_file_size &&
+		(ltt_lite_rb_file_pos + len) >= ltt_lite_file_size * SZ_1M) {
+		ltt_lite_rb_file_pos = 0;
+		result = sys_lseek(log_file_fd, 0, SEEK_SET);
+		if (result < 0)
+			printk(KERN_ERR "%s: seek error - %ld\n",
+				   __func__, result);
+	}
+	result = sys_writev(log_file_fd,
+				(const struct iovec __user *) ltt_lite_rb_iov, nr);
+	if (result < 0)
+		printk(KERN_ERR "%s: write error\n", __func__);
+	else
+		ltt_lite_rb_file_pos += result;
+}
+
+static void ltt_lite_rb_write_page(void *page)
+{
+	struct ring_buffer_event *event;
+	struct record_header_t *header;
+	unsigned offset = 0;
+	size_t len = 0;
+	int nr = 0;
+
+	while ((event = ring_buffer_page_event(page, &offset))) {
+		header = ring_buffer_event_data(event);
+		ltt_lite_rb_iov[nr].iov_base = header;
+		ltt_lite_rb_iov[nr].iov_len = header->ssize;
+		len += header->ssize;
+		if (++nr == LTT_LITE_RB_IOV) {
+			ltt_lite_rb_writev(nr, len);
+			nr = 0;
+			len = 0;
+		}
+	}
+	if (nr)
+		ltt_lite_rb_writev(nr, len);
+}
+
+/*
+ * write the full pages of every cpu to the log file, and with @all
+ * also the records on the pages the writers are still filling
+ */
+static void ltt_lite_rb_drain(int all)
+{
+	struct ring_buffer_event *event;
+	struct record_header_t *header;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		while (ring_buffer_read_page(ltt_lite_rb, &ltt_lite_rb_page,
+						 cpu, 1))
+			ltt_lite_rb_write_page(ltt_lite_rb_page);
+		if (!all)
+			continue;
+		while ((event = ring_buffer_consume(ltt_lite_rb, cpu, NULL))) {
+			header = ring_buffer_event_data(event);
+			ltt_lite_rb_iov[0].iov_base = header;
+			ltt_lite_rb_iov[0].iov_len = header->ssize;
+			ltt_lite_rb_writev(1, header->ssize);
+		}
+	}
+}
+
+static void wq_rb_drain(struct work_struct *ignore)
+{
+	UNUSED_PARAM(ignore);
+
+	if (!ltt_lite_is_enabled || !ltt_lite_rb_active)
+		return;
+	ltt_lite_rb_drain(0);
+	queue_delayed_work(ltt_lite_wq, &wq_rb_drain_work,
+			   LTT_LITE_RB_DRAIN_INTERVAL);
+}
+
+/* called by wq_init with the log file opened */
+static int ltt_lite_rb_open(void)
+{
+	struct ring_buffer *rb;
+	void *page;
+	int cpu;
+
+	if (!ltt_lite_rb) {
+		rb = ring_buffer_alloc(LTT_LITE_RB_SIZE, 0);
+		if (!rb)
+			return -ENOMEM;
+		page = ring_buffer_alloc_read_page(rb);
+		if (!page) {
+			ring_buffer_free(rb);
+			return -ENOMEM;
+		}
+		ltt_lite_rb = rb;
+		ltt_lite_rb_page = page;
+	} else
+		ring_buffer_record_enable(ltt_lite_rb);
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(ltt_lite_rb_lost, cpu), 0,
+			   sizeof(per_cpu(ltt_lite_rb_lost, cpu)));
+	ltt_lite_rb_file_pos = 0;
+	ltt_lite_rb_active = true;
+	queue_delayed_work(ltt_lite_wq, &wq_rb_drain_work,
+			   LTT_LITE_RB_DRAIN_INTERVAL);
+
+	return 0;
+}
+
+/* called by wq_close_file, writes the rest of the log and the report */
+static void ltt_lite_rb_close(void)
+{
+	struct ltt_lite_report_event lreport;
+	unsigned long lost[LTT_LITE_EV_LAST];
+	long result;
+	int cpu, i;
+
+	cancel_delayed_work(&wq_rb_drain_work);
+	ring_buffer_record_disable(ltt_lite_rb);
+	/* let the events already reserved be committed */
+	synchronize_sched();
+	ltt_lite_rb_drain(1);
+	ring_buffer_reset(ltt_lite_rb);
+
+	memset(lost, 0, sizeof(lost));
+	for_each_possible_cpu(cpu)
+		for (i = 0; i < LTT_LITE_EV_LAST; i++)
+			lost[i] += per_cpu(ltt_lite_rb_lost, cpu)[i];
+
+	memset(&lreport.header, 0, sizeof(struct record_header_t));
+	lreport.header.type = LTT_LITE_EV_REPORT;
+	lreport.header.ssize = sizeof(struct ltt_lite_report_event);
+	memcpy(&lreport.reports, &lost[LTT_LITE_EV_SYSCALL_ENTRY],
+		   REPORT_ITEM_LEN);
+	result = sys_write(log_file_fd, (char *) &lreport, sizeof(lreport));
+	if (result < 0)
+		printk(KERN_ERR "%s: write error\n", __func__);
+
+	result = sys_close(log_file_fd);
+	if (result < 0)
+		printk(KERN_ERR "%s: close error\n", __func__);
+	else
+		log_file_fd = -1;
+	ltt_lite_rb_active = false;
+}
+#else
+#define ltt_lite_rb_active false
+static inline void ltt_lite_rb_commit(void *addr, int size,
+					  unsigned short type) { }
+static inline int ltt_lite_rb_open(void) { return -ENODEV; }
+static inline void ltt_lite_rb_close(void) { }
+#endif /* CONFIG_LTT_LITE_RING_BUFFER */
+
 /* workqueue open file and mark ltt lite enabled here */
 static void wq_init(struct work_struct *ignore)
 {
@@ -831,7 +1033,8 @@ static void wq_init(struct work_struct *ignore)
 		return;
 	}
 
-	if (!ltt_lite_buf) {
+	if (!ltt_lite_buf &&
+		(use_private_ram_file || ltt_lite_rb_open() < 0)) {
 		printk(KERN_DEBUG "Ltt-lite wq-int ltt-lite-buff true\n");
 		if (!use_private_ram_file) {
 			buf = alloc_reserved_pages(&page_array,
@@ -1133,6 +1336,10 @@ static void wq_close_file(struct work_struct *ignore)
 	printk(KERN_DEBUG "LTT-LITE %s: wq_close_file enter\n", __func__);
 
 	BUG_ON(log_file_fd < 0);
+	if (ltt_lite_rb_active) {
+		ltt_lite_rb_close();
+		return;
+	}
 	/* write the log data has not be committed to log */
 	if (buf_info->is_top) {
 		start = ltt_lite_buf;
@@ -2018,6 +2225,8 @@ static inline void count_lost_event(unsigned short type)
  * declares two works for work queue, one writes top half while the
  * other writes bottom half. When complete writing file, the work
  * thread of workqueue release CPU immediately.
+ * With CONFIG_LTT_LITE_RING_BUFFER the normal mode records into the
+ * per-CPU ring buffer instead, see ltt_lite_rb_commit().
  */
 static void commit_log(void *addr, int size, unsigned short type)
 {
@@ -2026,6 +2235,11 @@ static void commit_log(void *addr, int size, unsigned short type)
 	header->type = type;
 	header->ssize = size;
 
+	if (ltt_lite_rb_active && !early_enabled_mode && !use_private_ram) {
+		ltt_lite_rb_commit(addr, size, type);
+		return;
+	}
+
 	if (irqs_disabled())
 		in_irq_handler = 1;
 	if (!in_irq_handler)
@@ -32,6 +32,7 @@
 #include <linux/security.h>
 #include <linux/bootmem.h>
 #include <linux/syscalls.h>
+#include <linux/kthread.h>
 #ifdef CONFIG_LTT_LITE
 #include <linux/lttlite-events.h>
 #endif
@@ -111,6 +112,9 @@ static unsigned log_start;	/* Index into log_buf: next char to be read by syslog
 static unsigned con_start;	/* Index into log_buf: next char to be sent to consoles */
 static unsigned log_end;	/* Index into log_buf: most-recently-written-char + 1 */
 
+/* Writes log_buf out to the consoles on behalf of printk() */
+static struct task_struct *printk_thread;
+
 /*
  *	Array of consoles built from command line options (console=)
  */
@@ -574,6 +578,22 @@ static int printk_time = 0;
 #endif
 module_param_named(time, printk_time, bool, S_IRUGO | S_IWUSR);
 
+/*
+ * Once the system is up, printk() only stores the message in the log
+ * buffer and leaves writing it to the consoles to printk_thread, rather
+ * than driving slow consoles itself with interrupts disabled.  Oopses
+ * and panics are still printed synchronously, as is everything when
+ * printk.sync is set.
+ */
+static int printk_sync;
+module_param_named(sync, printk_sync, bool, S_IRUGO | S_IWUSR);
+
+static inline int printk_deferred_output(void)
+{
+	return printk_thread && !printk_sync && !oops_in_progress &&
+		system_state == SYSTEM_RUNNING;
+}
+
 /* Check if we have any console registered that can be called early in boot. */
 static int have_callable_console(void)
 {
@@ -675,12 +695,15 @@ static int recursion_bug;
 static int new_text_line = 1;
 static char printk_buf[1024];
 
+static void printk_wake_thread(void);
+
 asmlinkage int vprintk(const char *fmt, va_list args)
 {
 	int printed_len = 0;
 	int current_log_level = default_message_loglevel;
 	unsigned long flags;
 	int this_cpu;
+	int deferred = 0;
 	char *p;
 
 	boot_delay_msec();
@@ -787,14 +810,23 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 * The acquire_console_semaphore_for_printk() function
 	 * will release 'logbuf_lock' regardless of whether it
 	 * actually gets the semaphore or not.
+	 *
+	 * Unless the output is left to printk_thread.
 	 */
-	if (acquire_console_semaphore_for_printk(this_cpu))
+	if (printk_deferred_output()) {
+		deferred = 1;
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+	} else if (acquire_console_semaphore_for_printk(this_cpu))
 		release_console_sem();
 
 	lockdep_on();
 out_restore_irqs:
 	raw_local_irq_restore(flags);
 
+	if (deferred)
+		printk_wake_thread();
+
 	preempt_enable();
 	return printed_len;
 }
@@ -962,6 +994,8 @@ void resume_console(void)
 	down(&console_sem);
 	console_suspended = 0;
 	release_console_sem();
+	if (printk_thread)
+		wake_up_process(printk_thread);
 }
 
 /**
@@ -1002,13 +1036,21 @@ int is_console_locked(void)
 	return console_locked;
 }
 
+#define PRINTK_PENDING_WAKEUP	0x01
+#define PRINTK_PENDING_OUTPUT	0x02
+
 static DEFINE_PER_CPU(int, printk_pending);
 
 void printk_tick(void)
 {
-	if (__get_cpu_var(printk_pending)) {
+	int pending = __get_cpu_var(printk_pending);
+
+	if (pending) {
 		__get_cpu_var(printk_pending) = 0;
-		wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_OUTPUT)
+			wake_up_process(printk_thread);
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
 	}
 }
 
@@ -1017,11 +1059,79 @@ int printk_needs_cpu(int cpu)
 	return per_cpu(printk_pending, cpu);
 }
 
+static void printk_set_pending(int bit)
+{
+	unsigned long flags;
+
+	raw_local_irq_save(flags);
+	__raw_get_cpu_var(printk_pending) |= bit;
+	raw_local_irq_restore(flags);
+}
+
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		__raw_get_cpu_var(printk_pending) = 1;
+		printk_set_pending(PRINTK_PENDING_WAKEUP);
+}
+
+#ifdef CONFIG_PRINTK
+/*
+ * Called by vprintk() after storing a message it does not print.  With
+ * interrupts enabled the caller cannot hold a runqueue lock, so the
+ * thread is woken right away; otherwise the wakeup is left to the next
+ * timer tick on this cpu.
+ */
+static void printk_wake_thread(void)
+{
+	unsigned long flags;
+
+	raw_local_save_flags(flags);
+	if (!raw_irqs_disabled_flags(flags))
+		wake_up_process(printk_thread);
+	else
+		printk_set_pending(PRINTK_PENDING_OUTPUT);
+}
+
+static int printk_thread_fn(void *unused)
+{
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		/*
+		 * An unlocked peek: a racing printk() wakes us again, and
+		 * so does resume_console() once the consoles can print.
+		 */
+		if (con_start == log_end || console_suspended)
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		acquire_console_sem();
+		release_console_sem();
+	}
+	return 0;
+}
+
+static int __init printk_thread_init(void)
+{
+	struct task_struct *p;
+
+	p = kthread_run(printk_thread_fn, NULL, "kconsole");
+	if (IS_ERR(p)) {
+		printk(KERN_ERR "printk: cannot start console thread, "
+		       "printing synchronously\n");
+		return PTR_ERR(p);
+	}
+	printk_thread = p;
+	return 0;
 }
+late_initcall(printk_thread_init);
+#endif
+
+/*
+ * Console drivers are called with interrupts disabled.  Hand them at
+ * most this many characters at a time, so that flushing a full log
+ * buffer to a slow serial console lets interrupts in between.
+ */
+#define CONSOLE_FLUSH_MAX	256
 
 /**
  * release_console_sem - unlock the console system
@@ -1057,7 +1167,9 @@ void release_console_sem(void)
 			break;			/* Nothing to print */
 		_con_start = con_start;
 		_log_end = log_end;
-		con_start = log_end;		/* Flush */
+		if (_log_end - _con_start > CONSOLE_FLUSH_MAX)
+			_log_end = _con_start + CONSOLE_FLUSH_MAX;
+		con_start = _log_end;		/* Flush */
 		spin_unlock(&logbuf_lock);
 		stop_critical_timings();	/* don't trace print latency */
 		call_console_drivers(_con_start, _log_end);
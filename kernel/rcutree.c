@@ -45,6 +45,7 @@
 #include <linux/cpu.h>
 #include <linux/mutex.h>
 #include <linux/time.h>
+#include <linux/kthread.h>
 
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 static struct lock_class_key rcu_lock_key;
@@ -930,12 +931,181 @@ static void rcu_do_batch(struct rcu_data *rdp)
 		rdp->blimit = blimit;
 
 	local_irq_restore(flags);
+}
+
+#ifdef CONFIG_RCU_CALLBACK_KTHREAD
+
+/*
+ * Per-CPU kthreads invoking the callbacks whose grace period has ended,
+ * so that a large batch of them, e.g. after many tasks exit, is run at
+ * the priority of an ordinary task instead of in softirq context ahead
+ * of everything else on the CPU.  Until they are spawned, and on a CPU
+ * whose kthread could not be started, callbacks are invoked from the
+ * softirq as before.
+ */
+static DEFINE_PER_CPU(struct task_struct *, rcu_cb_kthread);
+static int rcu_cb_kthreads_spawned;
+
+static int rcu_cpu_has_callbacks_ready(long cpu)
+{
+	return cpu_has_callbacks_ready_to_invoke(&per_cpu(rcu_data, cpu)) ||
+	       cpu_has_callbacks_ready_to_invoke(&per_cpu(rcu_bh_data, cpu));
+}
+
+static int rcu_cb_kthread_fn(void *__bind_cpu)
+{
+	long cpu = (long)__bind_cpu;
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	while (!kthread_should_stop()) {
+		preempt_disable();
+		if (!rcu_cpu_has_callbacks_ready(cpu)) {
+			preempt_enable_no_resched();
+			schedule();
+			preempt_disable();
+		}
+
+		__set_current_state(TASK_RUNNING);
+
+		while (rcu_cpu_has_callbacks_ready(cpu)) {
+			/* Preempt disable stops cpu going offline. */
+			if (cpu_is_offline(cpu))
+				goto wait_to_die;
+			/* Callbacks expect to run with softirqs disabled. */
+			local_bh_disable();
+			rcu_do_batch(&per_cpu(rcu_data, cpu));
+			rcu_do_batch(&per_cpu(rcu_bh_data, cpu));
+			local_bh_enable();
+			/* At most blimit callbacks of each flavor in one go. */
+			preempt_enable_no_resched();
+			cond_resched();
+			preempt_disable();
+			rcu_qsctr_inc(cpu);
+		}
+		preempt_enable();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+
+wait_to_die:
+	preempt_enable();
+	/* Wait for kthread_stop */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static int __cpuinit rcu_cb_kthread_create(long cpu)
+{
+	struct task_struct *t;
+
+	t = kthread_create(rcu_cb_kthread_fn, (void *)cpu, "rcuc/%ld", cpu);
+	if (IS_ERR(t))
+		return PTR_ERR(t);
+	kthread_bind(t, cpu);
+	per_cpu(rcu_cb_kthread, cpu) = t;
+	return 0;
+}
+
+static void rcu_cb_kthread_stop(long cpu)
+{
+	struct task_struct *t = per_cpu(rcu_cb_kthread, cpu);
+
+	if (!t)
+		return;
+	per_cpu(rcu_cb_kthread, cpu) = NULL;
+	kthread_stop(t);
+}
+
+static void __cpuinit rcu_cb_kthread_notify(unsigned long action, long cpu)
+{
+	if (!rcu_cb_kthreads_spawned)
+		return;
+
+	switch (action) {
+	case CPU_UP_PREPARE:
+	case CPU_UP_PREPARE_FROZEN:
+		if (rcu_cb_kthread_create(cpu))
+			printk(KERN_WARNING "rcuc/%ld: cannot start, invoking "
+			       "callbacks from softirq\n", cpu);
+		break;
+	case CPU_ONLINE:
+	case CPU_ONLINE_FROZEN:
+		if (per_cpu(rcu_cb_kthread, cpu))
+			wake_up_process(per_cpu(rcu_cb_kthread, cpu));
+		break;
+	case CPU_UP_CANCELED:
+	case CPU_UP_CANCELED_FROZEN:
+		if (!per_cpu(rcu_cb_kthread, cpu))
+			break;
+		/* Never ran: unbind so it can run.  Fall thru. */
+		kthread_bind(per_cpu(rcu_cb_kthread, cpu),
+			     cpumask_any(cpu_online_mask));
+	case CPU_DEAD:
+	case CPU_DEAD_FROZEN:
+		rcu_cb_kthread_stop(cpu);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Hand the ready callbacks of this CPU to its kthread, or invoke them
+ * here if it has none.
+ */
+static void rcu_invoke_callbacks(struct rcu_data *rdp)
+{
+	struct task_struct *t = __get_cpu_var(rcu_cb_kthread);
+
+	if (t) {
+		if (cpu_has_callbacks_ready_to_invoke(rdp))
+			wake_up_process(t);
+		return;
+	}
+	rcu_do_batch(rdp);
 
 	/* Re-raise the RCU softirq if there are callbacks remaining. */
 	if (cpu_has_callbacks_ready_to_invoke(rdp))
 		raise_softirq(RCU_SOFTIRQ);
 }
 
+static int __init rcu_spawn_cb_kthreads(void)
+{
+	long cpu;
+
+	rcu_cb_kthreads_spawned = 1;
+	for_each_online_cpu(cpu) {
+		rcu_cb_kthread_notify(CPU_UP_PREPARE, cpu);
+		rcu_cb_kthread_notify(CPU_ONLINE, cpu);
+	}
+	return 0;
+}
+early_initcall(rcu_spawn_cb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_CALLBACK_KTHREAD */
+
+static void __cpuinit rcu_cb_kthread_notify(unsigned long action, long cpu)
+{
+}
+
+static void rcu_invoke_callbacks(struct rcu_data *rdp)
+{
+	rcu_do_batch(rdp);
+
+	/* Re-raise the RCU softirq if there are callbacks remaining. */
+	if (cpu_has_callbacks_ready_to_invoke(rdp))
+		raise_softirq(RCU_SOFTIRQ);
+}
+
+#endif /* #else #ifdef CONFIG_RCU_CALLBACK_KTHREAD */
+
 /*
  * Check to see if this CPU is in a non-context-switch quiescent state
  * (user mode or idle loop for rcu, non-softirq execution for rcu_bh).
@@ -1144,7 +1314,7 @@ __rcu_process_callbacks(struct rcu_state *rsp, struct rcu_data *rdp)
 	}
 
 	/* If there are callbacks ready, invoke them. */
-	rcu_do_batch(rdp);
+	rcu_invoke_callbacks(rdp);
 }
 
 /*
@@ -1396,6 +1566,8 @@ static int __cpuinit rcu_cpu_notify(struct notifier_block *self,
 {
 	long cpu = (long)hcpu;
 
+	rcu_cb_kthread_notify(action, cpu);
+
 	switch (action) {
 	case CPU_UP_PREPARE:
 	case CPU_UP_PREPARE_FROZEN:
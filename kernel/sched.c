@@ -72,6 +72,7 @@
 #include <linux/debugfs.h>
 #include <linux/ctype.h>
 #include <linux/ftrace.h>
+#include <linux/cpufreq.h>
 #ifdef CONFIG_LTT_LITE
 #include <linux/lttlite-events.h>
 #endif
@@ -81,6 +82,7 @@
 #include <asm/irq_regs.h>
 
 #include "sched_cpupri.h"
+#include "workqueue_sched.h"
 
 /*
  * Convert user-nice values [ -20 ... 0 ... 19 ]
@@ -289,6 +291,11 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+	/*
+	 * wakeup latency hint: the wakeup preemption granularity and the
+	 * slice of the group's entities, in percent of the defaults
+	 */
+	unsigned int latency_pct;
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -298,6 +305,11 @@ struct task_group {
 	struct rt_bandwidth rt_bandwidth;
 #endif
 
+#ifdef CONFIG_SCHEDLAT
+	/* per cpu latency histograms of the group's own tasks */
+	struct sched_lat_hist *sched_lat;
+#endif
+
 	struct rcu_head rcu;
 	struct list_head list;
 
@@ -359,6 +371,14 @@ static DEFINE_SPINLOCK(task_group_lock);
 #define MIN_SHARES	2
 #define MAX_SHARES	(1UL << 18)
 
+/*
+ * A group's latency hint scales the wakeup granularity and slices of its
+ * entities between a tenth and ten times the sysctl values.
+ */
+#define DEFAULT_LATENCY_PCT	100
+#define MIN_LATENCY_PCT		10
+#define MAX_LATENCY_PCT		1000
+
 static int init_task_group_load = INIT_TASK_GROUP_LOAD;
 #endif
 
@@ -642,6 +662,9 @@ struct rq {
 	/* BKL stats */
 	unsigned int bkl_count;
 #endif
+#ifdef CONFIG_SCHEDLAT
+	struct sched_lat_hist sched_lat;
+#endif
 };
 
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct rq, runqueues);
@@ -1714,6 +1737,8 @@ static void update_avg(u64 *avg, u64 sample)
 static void enqueue_task(struct rq *rq, struct task_struct *p, int wakeup)
 {
 	sched_info_queued(p);
+	if (wakeup)
+		sched_lat_wakeup(p);
 	p->sched_class->enqueue_task(rq, p, wakeup);
 	p->se.on_rq = 1;
 }
@@ -2353,6 +2378,10 @@ out_activate:
 	activate_task(rq, p, 1);
 	success = 1;
 
+	/* if a worker is waking up, notify workqueue */
+	if (p->flags & PF_WQ_WORKER)
+		wq_worker_waking_up(p, cpu_of(rq));
+
 out_running:
 	trace_sched_wakeup(rq, p, success);
 	check_preempt_curr(rq, p, sync);
@@ -2370,6 +2399,40 @@ out:
 	return success;
 }
 
+/**
+ * try_to_wake_up_local - try to wake up a local task with rq lock held
+ * @p: the thread to be awakened
+ *
+ * Put @p on the run-queue if it's not already there.  The caller holds
+ * the lock of this_rq(), which @p must be on, and @p is not current.
+ * Used by schedule() to wake the workqueue worker taking over from a
+ * worker going to sleep.
+ */
+static void try_to_wake_up_local(struct task_struct *p)
+{
+	struct rq *rq = task_rq(p);
+
+	if (WARN_ON_ONCE(rq != this_rq()) || WARN_ON_ONCE(p == current))
+		return;
+
+	if (!(p->state & TASK_NORMAL))
+		return;
+
+	if (!p->se.on_rq) {
+		schedstat_inc(p, se.nr_wakeups);
+		schedstat_inc(p, se.nr_wakeups_local);
+		activate_task(rq, p, 1);
+	}
+	trace_sched_wakeup(rq, p, 1);
+	check_preempt_curr(rq, p, 0);
+
+	p->state = TASK_RUNNING;
+#ifdef CONFIG_SMP
+	if (p->sched_class->task_wake_up)
+		p->sched_class->task_wake_up(rq, p);
+#endif
+}
+
 int wake_up_process(struct task_struct *p)
 {
 	return try_to_wake_up(p, TASK_ALL, 0);
@@ -2449,6 +2512,9 @@ void sched_fork(struct task_struct *p, int clone_flags)
 	if (likely(sched_info_on()))
 		memset(&p->sched_info, 0, sizeof(p->sched_info));
 #endif
+#ifdef CONFIG_SCHEDLAT
+	memset(&p->sched_lat, 0, sizeof(p->sched_lat));
+#endif
 #if defined(CONFIG_SMP) && defined(__ARCH_WANT_UNLOCKED_CTXSW)
 	p->oncpu = 0;
 #endif
@@ -4271,6 +4337,7 @@ void account_user_time(struct task_struct *p, cputime_t cputime,
 	p->utime = cputime_add(p->utime, cputime);
 	p->utimescaled = cputime_add(p->utimescaled, cputime_scaled);
 	account_group_user_time(p, cputime);
+	cpufreq_account_uid_time(p, cputime);
 
 	/* Add user time to cpustat. */
 	tmp = cputime_to_cputime64(cputime);
@@ -4329,6 +4396,7 @@ void account_system_time(struct task_struct *p, int hardirq_offset,
 	p->stime = cputime_add(p->stime, cputime);
 	p->stimescaled = cputime_add(p->stimescaled, cputime_scaled);
 	account_group_system_time(p, cputime);
+	cpufreq_account_uid_time(p, cputime);
 
 	/* Add system time to cpustat. */
 	tmp = cputime_to_cputime64(cputime);
@@ -4669,8 +4737,20 @@ need_resched_nonpreemptible:
 	if (prev->state && !(preempt_count() & PREEMPT_ACTIVE)) {
 		if (unlikely(signal_pending_state(prev->state, prev)))
 			prev->state = TASK_RUNNING;
-		else
+		else {
+			/*
+			 * A workqueue worker going to sleep may have to
+			 * hand its pending work to another one.
+			 */
+			if (prev->flags & PF_WQ_WORKER) {
+				struct task_struct *to_wakeup;
+
+				to_wakeup = wq_worker_sleeping(prev, cpu);
+				if (to_wakeup)
+					try_to_wake_up_local(to_wakeup);
+			}
 			deactivate_task(rq, prev, 1);
+		}
 		switch_count = &prev->nvcsw;
 	}
 
@@ -8522,6 +8602,7 @@ void __init sched_init(void)
 		init_rt_rq(&rq->rt, rq);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 		init_task_group.shares = init_task_group_load;
+		init_task_group.latency_pct = DEFAULT_LATENCY_PCT;
 		INIT_LIST_HEAD(&rq->leaf_cfs_rq_list);
 #ifdef CONFIG_CGROUP_SCHED
 		/*
@@ -8546,6 +8627,7 @@ void __init sched_init(void)
 		init_tg_cfs_entry(&init_task_group, &rq->cfs, NULL, i, 1, NULL);
 #elif defined CONFIG_USER_SCHED
 		root_task_group.shares = NICE_0_LOAD;
+		root_task_group.latency_pct = DEFAULT_LATENCY_PCT;
 		init_tg_cfs_entry(&root_task_group, &rq->cfs, NULL, i, 0, NULL);
 		/*
 		 * In case of task-groups formed thr' the user id of tasks,
@@ -8819,6 +8901,7 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 		goto err;
 
 	tg->shares = NICE_0_LOAD;
+	tg->latency_pct = DEFAULT_LATENCY_PCT;
 
 	for_each_possible_cpu(i) {
 		rq = cpu_rq(i);
@@ -8965,6 +9048,9 @@ static void free_sched_group(struct task_group *tg)
 {
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
+#ifdef CONFIG_SCHEDLAT
+	free_percpu(tg->sched_lat);
+#endif
 	kfree(tg);
 }
 
@@ -8985,6 +9071,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+#ifdef CONFIG_SCHEDLAT
+	tg->sched_lat = alloc_percpu(struct sched_lat_hist);
+	if (!tg->sched_lat)
+		goto err;
+#endif
+
 	spin_lock_irqsave(&task_group_lock, flags);
 	for_each_possible_cpu(i) {
 		register_fair_sched_group(tg, i);
@@ -9161,6 +9253,29 @@ unsigned long sched_group_shares(struct task_group *tg)
 {
 	return tg->shares;
 }
+
+int sched_group_set_latency(struct task_group *tg, unsigned int latency_pct)
+{
+	/*
+	 * Like its weight, the latency hint of the root group is fixed.
+	 */
+	if (!tg->se[0])
+		return -EINVAL;
+
+	if (latency_pct < MIN_LATENCY_PCT)
+		latency_pct = MIN_LATENCY_PCT;
+	else if (latency_pct > MAX_LATENCY_PCT)
+		latency_pct = MAX_LATENCY_PCT;
+
+	/* only read at wakeup and tick time, a plain store will do */
+	tg->latency_pct = latency_pct;
+	return 0;
+}
+
+unsigned int sched_group_latency(struct task_group *tg)
+{
+	return tg->latency_pct;
+}
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -9514,6 +9629,19 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) tg->shares;
 }
+
+static int cpu_latency_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				 u64 latency_pct)
+{
+	if (latency_pct > MAX_LATENCY_PCT)
+		latency_pct = MAX_LATENCY_PCT;
+	return sched_group_set_latency(cgroup_tg(cgrp), latency_pct);
+}
+
+static u64 cpu_latency_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return (u64) sched_group_latency(cgroup_tg(cgrp));
+}
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -9540,6 +9668,31 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SCHEDLAT
+static int cpu_schedlat_show(struct cgroup *cgrp, struct cftype *cft,
+			     struct seq_file *m)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	struct sched_lat_hist *hist, sum;
+	int cpu, i;
+
+	/* the root group has all tasks, not only those it has itself */
+	if (!tg->sched_lat)
+		return sched_lat_show_cpus(m);
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		hist = per_cpu_ptr(tg->sched_lat, cpu);
+		for (i = 0; i < SCHEDLAT_BUCKETS; i++) {
+			sum.wakeup[i] += hist->wakeup[i];
+			sum.wait[i] += hist->wait[i];
+		}
+	}
+	sched_lat_hist_show(m, &sum);
+	return 0;
+}
+#endif
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -9547,6 +9700,11 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "latency_pct",
+		.read_u64 = cpu_latency_read_u64,
+		.write_u64 = cpu_latency_write_u64,
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
@@ -9560,6 +9718,12 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_rt_period_write_uint,
 	},
 #endif
+#ifdef CONFIG_SCHEDLAT
+	{
+		.name = "schedlat",
+		.read_seq_string = cpu_schedlat_show,
+	},
+#endif
 };
 
 static int cpu_cgroup_populate(struct cgroup_subsys *ss, struct cgroup *cont)
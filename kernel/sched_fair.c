@@ -186,6 +186,14 @@ find_matching_se(struct sched_entity **se, struct sched_entity **pse)
 	}
 }
 
+/* latency hint of the group a task is in, or of the group an entity is */
+static inline unsigned int entity_latency_pct(struct sched_entity *se)
+{
+	if (entity_is_task(se))
+		return cfs_rq_of(se)->tg->latency_pct;
+	return group_cfs_rq(se)->tg->latency_pct;
+}
+
 #else	/* CONFIG_FAIR_GROUP_SCHED */
 
 static inline struct rq *rq_of(struct cfs_rq *cfs_rq)
@@ -418,6 +426,23 @@ static u64 __sched_period(unsigned long nr_running)
 	return period;
 }
 
+/*
+ * Scale a slice or wakeup granularity by the latency hint of the group of
+ * @se: a group tuned for latency has its tasks preempt others sooner on
+ * wakeup and switch between them more often, a background group runs in
+ * longer slices.
+ */
+static inline u64 scale_latency(u64 delta, struct sched_entity *se)
+{
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	unsigned int pct = entity_latency_pct(se);
+
+	if (pct != 100)
+		delta = div_u64(delta * pct, 100);
+#endif
+	return delta;
+}
+
 /*
  * We calculate the wall-time slice from the period by taking a part
  * proportional to the weight.
@@ -428,6 +453,7 @@ static u64 sched_slice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
 	u64 slice = __sched_period(cfs_rq->nr_running + !se->on_rq);
 
+	slice = scale_latency(slice, se);
 	for_each_sched_entity(se) {
 		struct load_weight *load;
 
@@ -1350,7 +1376,7 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 	if (vdiff <= 0)
 		return -1;
 
-	gran = wakeup_gran(curr);
+	gran = scale_latency(wakeup_gran(curr), se);
 	if (vdiff > gran)
 		return 1;
 
@@ -104,6 +104,60 @@ static int __init proc_schedstat_init(void)
 }
 module_init(proc_schedstat_init);
 
+#ifdef CONFIG_SCHEDLAT
+void sched_lat_hist_show(struct seq_file *m, const struct sched_lat_hist *hist)
+{
+	int i;
+
+	for (i = 0; i < SCHEDLAT_BUCKETS; i++)
+		seq_printf(m, "%llu %u %u\n", i ? 512ULL << i : 0ULL,
+			   hist->wakeup[i], hist->wait[i]);
+}
+
+/* The histograms of all cpus added up. */
+static int sched_lat_show_cpus(struct seq_file *m)
+{
+	struct sched_lat_hist sum;
+	int cpu, i;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+
+		for (i = 0; i < SCHEDLAT_BUCKETS; i++) {
+			sum.wakeup[i] += rq->sched_lat.wakeup[i];
+			sum.wait[i] += rq->sched_lat.wait[i];
+		}
+	}
+	sched_lat_hist_show(m, &sum);
+	return 0;
+}
+
+static int schedlat_show(struct seq_file *m, void *v)
+{
+	return sched_lat_show_cpus(m);
+}
+
+static int schedlat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, schedlat_show, NULL);
+}
+
+static const struct file_operations schedlat_fops = {
+	.open    = schedlat_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static int __init schedlat_debugfs_init(void)
+{
+	debugfs_create_file("schedlat", 0444, NULL, NULL, &schedlat_fops);
+	return 0;
+}
+late_initcall(schedlat_debugfs_init);
+#endif /* CONFIG_SCHEDLAT */
+
 /*
  * Expects runqueue lock to be held for atomicity of update
  */
@@ -156,6 +210,64 @@ static inline void sched_info_reset_dequeued(struct task_struct *t)
 	t->sched_info.last_queued = 0;
 }
 
+#ifdef CONFIG_SCHEDLAT
+static inline int sched_lat_bucket(unsigned long long delta)
+{
+	return min_t(int, fls64(delta >> 10), SCHEDLAT_BUCKETS - 1);
+}
+
+static inline void sched_lat_add(struct sched_lat_hist *hist, int bucket,
+				 int wakeup)
+{
+	hist->wait[bucket]++;
+	if (wakeup)
+		hist->wakeup[bucket]++;
+}
+
+/*
+ * Called when a task finally hits the cpu, with the runqueue lock held:
+ * the task, cpu and group histograms it adds to are only ever updated
+ * under that lock, so they need no atomics.
+ */
+static void sched_lat_arrive(struct task_struct *t, unsigned long long delta)
+{
+	struct rq *rq = task_rq(t);
+	int wakeup = t->sched_info.lat_wakeup;
+	int bucket;
+#ifdef CONFIG_GROUP_SCHED
+	struct task_group *tg = task_group(t);
+#endif
+
+	bucket = sched_lat_bucket(t->sched_info.lat_delay + delta);
+	t->sched_info.lat_delay = 0;
+	t->sched_info.lat_wakeup = 0;
+
+	sched_lat_add(&t->sched_lat, bucket, wakeup);
+	sched_lat_add(&rq->sched_lat, bucket, wakeup);
+#ifdef CONFIG_GROUP_SCHED
+	if (tg->sched_lat)
+		sched_lat_add(per_cpu_ptr(tg->sched_lat, cpu_of(rq)),
+			      bucket, wakeup);
+#endif
+}
+
+/* A task taken off a runqueue before it ran goes on waiting elsewhere. */
+static inline void sched_lat_dequeued(struct task_struct *t,
+				      unsigned long long delta)
+{
+	t->sched_info.lat_delay += delta;
+}
+
+static inline void sched_lat_wakeup(struct task_struct *t)
+{
+	t->sched_info.lat_wakeup = 1;
+}
+#else
+#define sched_lat_arrive(t, delta)		do { } while (0)
+#define sched_lat_dequeued(t, delta)		do { } while (0)
+#define sched_lat_wakeup(t)			do { } while (0)
+#endif /* CONFIG_SCHEDLAT */
+
 /*
  * Called when a process is dequeued from the active array and given
  * the cpu.  We should note that with the exception of interactive
@@ -179,6 +291,7 @@ static inline void sched_info_dequeued(struct task_struct *t)
 			delta = now - t->sched_info.last_queued;
 	sched_info_reset_dequeued(t);
 	t->sched_info.run_delay += delta;
+	sched_lat_dequeued(t, delta);
 
 	rq_sched_info_dequeued(task_rq(t), delta);
 }
@@ -198,6 +311,7 @@ static void sched_info_arrive(struct task_struct *t)
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
 	t->sched_info.pcount++;
+	sched_lat_arrive(t, delta);
 
 	rq_sched_info_arrive(task_rq(t), delta);
 }
@@ -270,6 +384,7 @@ sched_info_switch(struct task_struct *prev, struct task_struct *next)
 		__sched_info_switch(prev, next);
 }
 #else
+#define sched_lat_wakeup(t)			do { } while (0)
 #define sched_info_queued(t)			do { } while (0)
 #define sched_info_reset_dequeued(t)	do { } while (0)
 #define sched_info_dequeued(t)			do { } while (0)
@@ -2462,6 +2462,39 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 	return ret;
 }
 
+/**
+ * ring_buffer_page_event - walk the data events of an extracted page
+ * @data_page: a page filled by ring_buffer_read_page
+ * @offset: offset into the page, start with zero
+ *
+ * Lets a reader that swapped out a whole page with ring_buffer_read_page
+ * hand the records on without consuming them one at a time. Time extend
+ * events are skipped and @offset is advanced past the returned event.
+ *
+ * Returns:
+ *  The next data event, or NULL at the end of the committed data.
+ */
+struct ring_buffer_event *
+ring_buffer_page_event(void *data_page, unsigned *offset)
+{
+	struct buffer_data_page *bpage = data_page;
+	struct ring_buffer_event *event;
+	unsigned commit = local_read(&bpage->commit);
+
+	while (*offset < commit) {
+		event = (void *)&bpage->data[*offset];
+		/* padding fills the rest of the page */
+		if (event->type == RINGBUF_TYPE_PADDING)
+			break;
+		*offset += rb_event_length(event);
+		if (event->type == RINGBUF_TYPE_DATA)
+			return event;
+	}
+
+	return NULL;
+}
+
+#ifdef CONFIG_TRACING
 static ssize_t
 rb_simple_read(struct file *filp, char __user *ubuf,
 	       size_t cnt, loff_t *ppos)
@@ -2532,3 +2565,4 @@ static __init int rb_init_debugfs(void)
 }
 
 fs_initcall(rb_init_debugfs);
+#endif /* CONFIG_TRACING */
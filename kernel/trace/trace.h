@@ -548,6 +548,8 @@ print_graph_function(struct trace_iterator *iter)
 
 extern struct pid *ftrace_pid_trace;
 
+/* the ring buffer may be built for other users without the tracers */
+#ifdef CONFIG_TRACING
 static inline int ftrace_trace_task(struct task_struct *task)
 {
 	if (!ftrace_pid_trace)
@@ -555,6 +557,7 @@ static inline int ftrace_trace_task(struct task_struct *task)
 
 	return test_tsk_trace_trace(task);
 }
+#endif
 
 /*
  * trace_iterator_flags is an enumeration that defines bit
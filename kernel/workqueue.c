@@ -34,6 +34,80 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 
+#include "workqueue_sched.h"
+
+/*
+ * Workqueues do not have threads of their own on every CPU; they share a
+ * pool of worker threads per CPU.  A cwq with work on it sits on the
+ * pending list of its pool until a worker takes it, and only one worker
+ * runs a cwq at a time, so the works of a cwq still run one after the
+ * other in the order they were queued.
+ *
+ * A pool runs one worker at a time as long as that worker keeps the CPU.
+ * When it blocks, the scheduler tells us through wq_worker_sleeping() and
+ * an idle worker is woken to go on with the other pending cwqs.  A worker
+ * about to run work makes sure another idle one is left to be woken, and
+ * workers which have been idle for IDLE_WORKER_TIMEOUT are let go again.
+ *
+ * Single threaded, freezeable and rt workqueues keep their own threads:
+ * a shared worker can neither be frozen along with one workqueue nor run
+ * at its priority, and the work functions of single threaded workqueues
+ * have always been free to change the scheduling policy of their thread.
+ * So do reclaim workqueues: a new worker needs memory and a fork, which
+ * the work reclaim waits for must not depend on.
+ */
+
+enum {
+	/* pool->flags */
+	POOL_MANAGING		= 1 << 0,	/* a worker is creating another */
+	POOL_DISASSOCIATED	= 1 << 1,	/* the cpu is not online */
+	POOL_DYING		= 1 << 2,	/* workers exit instead of idling */
+
+	/* worker->flags */
+	WORKER_IDLE		= 1 << 0,
+	WORKER_PREP		= 1 << 1,	/* not running work yet */
+	WORKER_UNBOUND		= 1 << 2,	/* not bound to the pool's cpu */
+	WORKER_DIE		= 1 << 3,
+
+	/* these keep a worker out of pool->nr_running */
+	WORKER_NOT_RUNNING	= WORKER_IDLE | WORKER_PREP | WORKER_UNBOUND,
+
+	MAX_IDLE_WORKERS_RATIO	= 4,		/* 1/4 of busy can be idle */
+	IDLE_WORKER_TIMEOUT	= 300 * HZ,	/* keep idle ones for 5 mins */
+};
+
+struct worker_pool {
+	spinlock_t		lock;
+	int			cpu;
+	unsigned int		flags;
+
+	struct list_head	pending;	/* cwqs waiting for a worker */
+	struct list_head	idle_list;	/* most recently idle first */
+	struct list_head	workers;	/* all started workers */
+	int			nr_workers;
+	int			nr_idle;
+	int			next_id;
+
+	/* workers running work and not blocked, for bound pools */
+	atomic_t		nr_running;
+
+	struct timer_list	idle_timer;
+	struct worker		*first_worker;	/* from CPU_UP_PREPARE */
+	struct completion	workers_gone;
+};
+
+struct worker {
+	struct list_head	entry;		/* on pool->idle_list */
+	struct list_head	node;		/* on pool->workers */
+	struct task_struct	*task;
+	struct worker_pool	*pool;
+	struct cpu_workqueue_struct *cwq;	/* the cwq being run */
+	unsigned int		flags;
+	unsigned long		last_active;	/* when it became idle */
+};
+
+static DEFINE_PER_CPU(struct worker_pool, cpu_worker_pool);
+
 /*
  * The per-CPU workqueue (if single thread, we always use the first
  * possible cpu).
@@ -48,6 +122,15 @@ struct cpu_workqueue_struct {
 
 	struct workqueue_struct *wq;
 	struct task_struct *thread;
+
+	/*
+	 * Unless the workqueue has a thread of its own: the pool running
+	 * it, the worker it is taken by and the entry on pool->pending.
+	 * The latter two are protected by pool->lock.
+	 */
+	struct worker_pool *pool;
+	struct worker *worker;
+	struct list_head pool_entry;
 } ____cacheline_aligned;
 
 /*
@@ -61,6 +144,7 @@ struct workqueue_struct {
 	int singlethread;
 	int freezeable;		/* Freeze threads during suspend */
 	int rt;
+	int reclaim;		/* Memory reclaim may wait for its work */
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
 #endif
@@ -87,6 +171,12 @@ static inline int is_wq_single_threaded(struct workqueue_struct *wq)
 	return wq->singlethread;
 }
 
+/* Does the workqueue have threads of its own, rather than a worker pool? */
+static inline int wq_has_threads(struct workqueue_struct *wq)
+{
+	return wq->singlethread || wq->freezeable || wq->rt || wq->reclaim;
+}
+
 static const struct cpumask *wq_cpu_map(struct workqueue_struct *wq)
 {
 	return is_wq_single_threaded(wq)
@@ -123,9 +213,121 @@ struct cpu_workqueue_struct *get_wq_data(struct work_struct *work)
 	return (void *) (atomic_long_read(&work->data) & WORK_STRUCT_WQ_DATA_MASK);
 }
 
+/* Does the pool run its workers on its cpu, with concurrency managed? */
+static inline int pool_bound(struct worker_pool *pool)
+{
+	return !(pool->flags & POOL_DISASSOCIATED);
+}
+
+/*
+ * A bound pool needs a worker woken when there are pending cwqs and none
+ * of its workers is running; an unbound one whenever cwqs are pending.
+ */
+static inline int need_more_worker(struct worker_pool *pool)
+{
+	return !list_empty(&pool->pending) &&
+		(!pool_bound(pool) || !atomic_read(&pool->nr_running));
+}
+
+/* Should a worker done with a work go on with the next pending cwq? */
+static inline int keep_working(struct worker_pool *pool)
+{
+	return !list_empty(&pool->pending) &&
+		(!pool_bound(pool) || atomic_read(&pool->nr_running) <= 1);
+}
+
+static inline int too_many_workers(struct worker_pool *pool)
+{
+	int nr_idle = pool->nr_idle;
+	int nr_busy = pool->nr_workers - nr_idle;
+
+	return nr_idle > 2 && (nr_idle - 2) * MAX_IDLE_WORKERS_RATIO >= nr_busy;
+}
+
+static struct worker *first_idle_worker(struct worker_pool *pool)
+{
+	if (list_empty(&pool->idle_list))
+		return NULL;
+	return list_first_entry(&pool->idle_list, struct worker, entry);
+}
+
+static void wake_up_worker(struct worker_pool *pool)
+{
+	struct worker *worker = first_idle_worker(pool);
+
+	if (likely(worker))
+		wake_up_process(worker->task);
+}
+
+/*
+ * Worker flags are only changed by the worker itself under pool->lock,
+ * which keeps pool->nr_running in step with the scheduler hooks below.
+ */
+static void worker_set_flags(struct worker *worker, unsigned int flags)
+{
+	if ((flags & WORKER_NOT_RUNNING) &&
+	    !(worker->flags & WORKER_NOT_RUNNING))
+		atomic_dec(&worker->pool->nr_running);
+	worker->flags |= flags;
+}
+
+static void worker_clr_flags(struct worker *worker, unsigned int flags)
+{
+	unsigned int oflags = worker->flags;
+
+	worker->flags &= ~flags;
+	if ((oflags & WORKER_NOT_RUNNING) &&
+	    !(worker->flags & WORKER_NOT_RUNNING))
+		atomic_inc(&worker->pool->nr_running);
+}
+
+/**
+ * wq_worker_waking_up - a worker is waking up
+ * @task: the worker task
+ * @cpu: the cpu it is woken on
+ *
+ * Called from try_to_wake_up() with the runqueue lock held.
+ */
+void wq_worker_waking_up(struct task_struct *task, unsigned int cpu)
+{
+	struct worker *worker = task->wq_worker;
+
+	if (!(worker->flags & WORKER_NOT_RUNNING) && worker->pool->cpu == cpu)
+		atomic_inc(&worker->pool->nr_running);
+}
+
+/**
+ * wq_worker_sleeping - a worker is going to sleep
+ * @task: the worker task, current
+ * @cpu: the cpu it is running on
+ *
+ * Called from schedule() with the runqueue lock held, so pool->lock can't
+ * be taken.  The pending and idle lists are only looked at: the idle list
+ * only changes on this cpu with interrupts off, and insert_work() sees
+ * nr_running drop to zero if we miss the cwq it has just made pending.
+ *
+ * Returns an idle worker of the same cpu to wake, or NULL.
+ */
+struct task_struct *wq_worker_sleeping(struct task_struct *task,
+				       unsigned int cpu)
+{
+	struct worker *worker = task->wq_worker, *to_wakeup = NULL;
+	struct worker_pool *pool = worker->pool;
+
+	if ((worker->flags & WORKER_NOT_RUNNING) || pool->cpu != cpu)
+		return NULL;
+
+	if (atomic_dec_and_test(&pool->nr_running) &&
+	    !list_empty(&pool->pending))
+		to_wakeup = first_idle_worker(pool);
+	return to_wakeup ? to_wakeup->task : NULL;
+}
+
 static void insert_work(struct cpu_workqueue_struct *cwq,
 			struct work_struct *work, struct list_head *head)
 {
+	struct worker_pool *pool = cwq->pool;
+
 	set_wq_data(work, cwq);
 	/*
 	 * Ensure that we get the right work->data if we see the
@@ -133,7 +335,22 @@ static void insert_work(struct cpu_workqueue_struct *cwq,
 	 */
 	smp_wmb();
 	list_add_tail(&work->entry, head);
-	wake_up(&cwq->more_work);
+
+	if (!pool) {
+		wake_up(&cwq->more_work);
+		return;
+	}
+
+	/* A cwq taken by a worker is put back by it if work is left. */
+	spin_lock(&pool->lock);
+	if (!cwq->worker && list_empty(&cwq->pool_entry)) {
+		list_add_tail(&cwq->pool_entry, &pool->pending);
+		/* pairs with atomic_dec_and_test() in wq_worker_sleeping() */
+		smp_mb();
+		if (need_more_worker(pool))
+			wake_up_worker(pool);
+	}
+	spin_unlock(&pool->lock);
 }
 
 static void __queue_work(struct cpu_workqueue_struct *cwq,
@@ -257,55 +474,64 @@ int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 }
 EXPORT_SYMBOL_GPL(queue_delayed_work_on);
 
-static void run_workqueue(struct cpu_workqueue_struct *cwq)
+/*
+ * Runs the first work on cwq->worklist.  Called and returns with cwq->lock
+ * held, interrupts disabled.
+ */
+static void run_one_work(struct cpu_workqueue_struct *cwq)
 {
-	spin_lock_irq(&cwq->lock);
-	while (!list_empty(&cwq->worklist)) {
-		struct work_struct *work = list_entry(cwq->worklist.next,
-						struct work_struct, entry);
-		work_func_t f = work->func;
+	struct work_struct *work = list_entry(cwq->worklist.next,
+					struct work_struct, entry);
+	work_func_t f = work->func;
 #ifdef CONFIG_LOCKDEP
-		/*
-		 * It is permissible to free the struct work_struct
-		 * from inside the function that is called from it,
-		 * this we need to take into account for lockdep too.
-		 * To avoid bogus "held lock freed" warnings as well
-		 * as problems when looking into work->lockdep_map,
-		 * make a copy and use that here.
-		 */
-		struct lockdep_map lockdep_map = work->lockdep_map;
+	/*
+	 * It is permissible to free the struct work_struct
+	 * from inside the function that is called from it,
+	 * this we need to take into account for lockdep too.
+	 * To avoid bogus "held lock freed" warnings as well
+	 * as problems when looking into work->lockdep_map,
+	 * make a copy and use that here.
+	 */
+	struct lockdep_map lockdep_map = work->lockdep_map;
 #endif
 
-		cwq->current_work = work;
-		list_del_init(cwq->worklist.next);
-		spin_unlock_irq(&cwq->lock);
-
-		BUG_ON(get_wq_data(work) != cwq);
-		work_clear_pending(work);
-		lock_map_acquire(&cwq->wq->lockdep_map);
-		lock_map_acquire(&lockdep_map);
-		f(work);
-		lock_map_release(&lockdep_map);
-		lock_map_release(&cwq->wq->lockdep_map);
+	cwq->current_work = work;
+	list_del_init(cwq->worklist.next);
+	spin_unlock_irq(&cwq->lock);
 
-		if (unlikely(in_atomic() || lockdep_depth(current) > 0)) {
-			printk(KERN_ERR "BUG: workqueue leaked lock or atomic: "
-					"%s/0x%08x/%d\n",
-					current->comm, preempt_count(),
-				       	task_pid_nr(current));
-			printk(KERN_ERR "    last function: ");
-			print_symbol("%s\n", (unsigned long)f);
-			debug_show_held_locks(current);
-			dump_stack();
-		}
+	BUG_ON(get_wq_data(work) != cwq);
+	work_clear_pending(work);
+	lock_map_acquire(&cwq->wq->lockdep_map);
+	lock_map_acquire(&lockdep_map);
+	f(work);
+	lock_map_release(&lockdep_map);
+	lock_map_release(&cwq->wq->lockdep_map);
 
-		spin_lock_irq(&cwq->lock);
-		cwq->current_work = NULL;
+	if (unlikely(in_atomic() || lockdep_depth(current) > 0)) {
+		printk(KERN_ERR "BUG: workqueue leaked lock or atomic: "
+				"%s/0x%08x/%d\n",
+				current->comm, preempt_count(),
+			       	task_pid_nr(current));
+		printk(KERN_ERR "    last function: ");
+		print_symbol("%s\n", (unsigned long)f);
+		debug_show_held_locks(current);
+		dump_stack();
 	}
+
+	spin_lock_irq(&cwq->lock);
+	cwq->current_work = NULL;
+}
+
+static void run_workqueue(struct cpu_workqueue_struct *cwq)
+{
+	spin_lock_irq(&cwq->lock);
+	while (!list_empty(&cwq->worklist))
+		run_one_work(cwq);
 	spin_unlock_irq(&cwq->lock);
 }
 
-static int worker_thread(void *__cwq)
+/* The thread of a workqueue which doesn't use a worker pool. */
+static int workqueue_thread(void *__cwq)
 {
 	struct cpu_workqueue_struct *cwq = __cwq;
 	DEFINE_WAIT(wait);
@@ -334,6 +560,245 @@ static int worker_thread(void *__cwq)
 	return 0;
 }
 
+/*
+ * Runs one work of a cwq taken off pool->pending, then lets go of the cwq,
+ * putting it back at the end of the pending list if it has more work, so
+ * that a busy workqueue doesn't hold up the others of the pool.
+ */
+static void process_cwq(struct worker *worker, struct cpu_workqueue_struct *cwq)
+{
+	struct worker_pool *pool = worker->pool;
+
+	spin_lock_irq(&cwq->lock);
+	/* the work which made it pending may have been cancelled since */
+	if (!list_empty(&cwq->worklist))
+		run_one_work(cwq);
+
+	spin_lock(&pool->lock);
+	worker->cwq = NULL;
+	cwq->worker = NULL;
+	if (!list_empty(&cwq->worklist))
+		list_add_tail(&cwq->pool_entry, &pool->pending);
+	spin_unlock(&pool->lock);
+	spin_unlock_irq(&cwq->lock);
+}
+
+static void worker_enter_idle(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+
+	worker_set_flags(worker, WORKER_IDLE);
+	pool->nr_idle++;
+	worker->last_active = jiffies;
+	list_add(&worker->entry, &pool->idle_list);
+
+	if (too_many_workers(pool) && !timer_pending(&pool->idle_timer))
+		mod_timer(&pool->idle_timer, jiffies + IDLE_WORKER_TIMEOUT);
+}
+
+static void worker_leave_idle(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+
+	worker_set_flags(worker, WORKER_PREP);
+	worker_clr_flags(worker, WORKER_IDLE);
+	pool->nr_idle--;
+	list_del_init(&worker->entry);
+}
+
+static int worker_thread(void *__worker);
+
+/*
+ * Creates a worker for @pool, bound to its cpu if it is online.  The
+ * worker is started with start_worker(), or dropped with discard_worker().
+ */
+static struct worker *create_worker(struct worker_pool *pool)
+{
+	struct worker *worker;
+	int id;
+
+	worker = kzalloc(sizeof(*worker), GFP_KERNEL);
+	if (!worker)
+		return NULL;
+
+	INIT_LIST_HEAD(&worker->entry);
+	INIT_LIST_HEAD(&worker->node);
+	worker->pool = pool;
+	worker->flags = WORKER_PREP;
+
+	spin_lock_irq(&pool->lock);
+	id = pool->next_id++;
+	spin_unlock_irq(&pool->lock);
+
+	worker->task = kthread_create(worker_thread, worker, "kworker/%d:%d",
+				      pool->cpu, id);
+	if (IS_ERR(worker->task)) {
+		kfree(worker);
+		return NULL;
+	}
+
+	if (pool_bound(pool))
+		kthread_bind(worker->task, pool->cpu);
+	else
+		worker->flags |= WORKER_UNBOUND;
+
+	return worker;
+}
+
+/* Called with pool->lock held. */
+static void start_worker(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+
+	list_add_tail(&worker->node, &pool->workers);
+	pool->nr_workers++;
+	worker_enter_idle(worker);
+	wake_up_process(worker->task);
+}
+
+static void discard_worker(struct worker *worker)
+{
+	kthread_stop(worker->task);
+	kfree(worker);
+}
+
+/*
+ * Called with pool->lock held; @worker must be idle.  The worker frees
+ * itself once it runs.
+ */
+static void destroy_worker(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+
+	pool->nr_idle--;
+	list_del_init(&worker->entry);
+	worker->flags |= WORKER_DIE;
+	wake_up_process(worker->task);
+}
+
+static void idle_worker_timeout(unsigned long __pool)
+{
+	struct worker_pool *pool = (struct worker_pool *)__pool;
+
+	spin_lock_irq(&pool->lock);
+	while (too_many_workers(pool)) {
+		struct worker *worker;
+		unsigned long expires;
+
+		/* the tail of idle_list has been idle the longest */
+		worker = list_entry(pool->idle_list.prev, struct worker, entry);
+		expires = worker->last_active + IDLE_WORKER_TIMEOUT;
+		if (time_before(jiffies, expires)) {
+			mod_timer(&pool->idle_timer, expires);
+			break;
+		}
+		destroy_worker(worker);
+	}
+	spin_unlock_irq(&pool->lock);
+}
+
+/*
+ * Called with pool->lock held by a worker about to run work when no idle
+ * worker is left, to create the one which takes over should it block.
+ * Drops pool->lock meanwhile.  Returns 1 if a worker was added.
+ */
+static int manage_workers(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+	struct worker *new;
+
+	pool->flags |= POOL_MANAGING;
+	spin_unlock_irq(&pool->lock);
+
+	new = create_worker(pool);
+
+	spin_lock_irq(&pool->lock);
+	pool->flags &= ~POOL_MANAGING;
+	if (!new)
+		return 0;
+
+	/* the cpu may have gone away while the worker was created */
+	if ((pool->flags & POOL_DYING) ||
+	    (!(new->flags & WORKER_UNBOUND) && !pool_bound(pool))) {
+		spin_unlock_irq(&pool->lock);
+		discard_worker(new);
+		spin_lock_irq(&pool->lock);
+		return 0;
+	}
+
+	start_worker(new);
+	return 1;
+}
+
+static int worker_thread(void *__worker)
+{
+	struct worker *worker = __worker;
+	struct worker_pool *pool = worker->pool;
+	struct cpu_workqueue_struct *cwq;
+	int managed;
+
+	current->wq_worker = worker;
+	current->flags |= PF_WQ_WORKER;
+	set_user_nice(current, -5);
+woke_up:
+	spin_lock_irq(&pool->lock);
+
+	if (unlikely(worker->flags & WORKER_DIE)) {
+		current->flags &= ~PF_WQ_WORKER;
+		list_del(&worker->node);
+		if (!--pool->nr_workers && (pool->flags & POOL_DYING))
+			complete(&pool->workers_gone);
+		spin_unlock_irq(&pool->lock);
+		kfree(worker);
+		return 0;
+	}
+
+	worker_leave_idle(worker);
+	managed = 0;
+recheck:
+	if (!need_more_worker(pool))
+		goto sleep;
+
+	/*
+	 * Leave an idle worker behind to be woken if we block.  Should
+	 * creating one fail, go on regardless: none of the pool's work is
+	 * needed to free memory, reclaim workqueues have their own threads.
+	 */
+	if (unlikely(!pool->nr_idle) && !(pool->flags & POOL_MANAGING) &&
+	    !managed) {
+		manage_workers(worker);
+		managed = 1;
+		goto recheck;
+	}
+
+	worker_clr_flags(worker, WORKER_PREP);
+	do {
+		cwq = list_first_entry(&pool->pending,
+				       struct cpu_workqueue_struct, pool_entry);
+		list_del_init(&cwq->pool_entry);
+		cwq->worker = worker;
+		worker->cwq = cwq;
+		spin_unlock_irq(&pool->lock);
+
+		process_cwq(worker, cwq);
+
+		spin_lock_irq(&pool->lock);
+	} while (keep_working(pool));
+	worker_set_flags(worker, WORKER_PREP);
+sleep:
+	if (unlikely(pool->flags & POOL_DYING)) {
+		worker->flags |= WORKER_DIE;
+		spin_unlock_irq(&pool->lock);
+		goto woke_up;
+	}
+
+	worker_enter_idle(worker);
+	__set_current_state(TASK_INTERRUPTIBLE);
+	spin_unlock_irq(&pool->lock);
+	schedule();
+	goto woke_up;
+}
+
 struct wq_barrier {
 	struct work_struct	work;
 	struct completion	done;
@@ -356,12 +821,23 @@ static void insert_wq_barrier(struct cpu_workqueue_struct *cwq,
 	insert_work(cwq, &barr->work, head);
 }
 
+/* Is current running @cwq, and so can't wait for it? */
+static int current_runs_cwq(struct cpu_workqueue_struct *cwq)
+{
+	if (current->flags & PF_WQ_WORKER) {
+		struct worker *worker = current->wq_worker;
+
+		return worker->cwq == cwq;
+	}
+	return cwq->thread == current;
+}
+
 static int flush_cpu_workqueue(struct cpu_workqueue_struct *cwq)
 {
 	int active = 0;
 	struct wq_barrier barr;
 
-	WARN_ON(cwq->thread == current);
+	WARN_ON(current_runs_cwq(cwq));
 
 	spin_lock_irq(&cwq->lock);
 	if (!list_empty(&cwq->worklist) || cwq->current_work != NULL) {
@@ -719,18 +1195,14 @@ int keventd_up(void)
 
 int current_is_keventd(void)
 {
-	struct cpu_workqueue_struct *cwq;
-	int cpu = raw_smp_processor_id(); /* preempt-safe: keventd is per-cpu */
-	int ret = 0;
+	struct worker *worker = current->wq_worker;
 
 	BUG_ON(!keventd_wq);
 
-	cwq = per_cpu_ptr(keventd_wq->cpu_wq, cpu);
-	if (current == cwq->thread)
-		ret = 1;
-
-	return ret;
-
+	/* keventd runs on the worker pools */
+	if (!(current->flags & PF_WQ_WORKER))
+		return 0;
+	return worker->cwq && worker->cwq->wq == keventd_wq;
 }
 
 static struct cpu_workqueue_struct *
@@ -742,6 +1214,12 @@ init_cpu_workqueue(struct workqueue_struct *wq, int cpu)
 	spin_lock_init(&cwq->lock);
 	INIT_LIST_HEAD(&cwq->worklist);
 	init_waitqueue_head(&cwq->more_work);
+	INIT_LIST_HEAD(&cwq->pool_entry);
+
+	if (wq_has_threads(wq))
+		cwq->pool = NULL;
+	else
+		cwq->pool = &per_cpu(cpu_worker_pool, cpu);
 
 	return cwq;
 }
@@ -753,7 +1231,11 @@ static int create_workqueue_thread(struct cpu_workqueue_struct *cwq, int cpu)
 	const char *fmt = is_wq_single_threaded(wq) ? "%s" : "%s/%d";
 	struct task_struct *p;
 
-	p = kthread_create(worker_thread, cwq, fmt, wq->name, cpu);
+	/* the worker pools serve it */
+	if (cwq->pool)
+		return 0;
+
+	p = kthread_create(workqueue_thread, cwq, fmt, wq->name, cpu);
 	/*
 	 * Nobody can add the work_struct to this cwq,
 	 *	if (caller is __create_workqueue)
@@ -786,6 +1268,7 @@ struct workqueue_struct *__create_workqueue_key(const char *name,
 						int singlethread,
 						int freezeable,
 						int rt,
+						int reclaim,
 						struct lock_class_key *key,
 						const char *lock_name)
 {
@@ -808,6 +1291,7 @@ struct workqueue_struct *__create_workqueue_key(const char *name,
 	wq->singlethread = singlethread;
 	wq->freezeable = freezeable;
 	wq->rt = rt;
+	wq->reclaim = reclaim;
 	INIT_LIST_HEAD(&wq->list);
 
 	if (singlethread) {
@@ -849,8 +1333,38 @@ struct workqueue_struct *__create_workqueue_key(const char *name,
 }
 EXPORT_SYMBOL_GPL(__create_workqueue_key);
 
+/*
+ * The worker which ran the barrier of a flush still holds the cwq for a
+ * moment after the flush returned.  Wait for it to let go.
+ */
+static void wait_for_cwq_release(struct cpu_workqueue_struct *cwq)
+{
+	struct worker_pool *pool = cwq->pool;
+	int busy;
+
+	for (;;) {
+		spin_lock_irq(&cwq->lock);
+		spin_lock(&pool->lock);
+		busy = cwq->worker || !list_empty(&cwq->pool_entry);
+		spin_unlock(&pool->lock);
+		spin_unlock_irq(&cwq->lock);
+		if (!busy)
+			break;
+		schedule_timeout_uninterruptible(1);
+	}
+}
+
 static void cleanup_workqueue_thread(struct cpu_workqueue_struct *cwq)
 {
+	if (cwq->pool) {
+		lock_map_acquire(&cwq->wq->lockdep_map);
+		lock_map_release(&cwq->wq->lockdep_map);
+
+		flush_cpu_workqueue(cwq);
+		wait_for_cwq_release(cwq);
+		return;
+	}
+
 	/*
 	 * Our caller is either destroy_workqueue() or CPU_POST_DEAD,
 	 * cpu_add_remove_lock protects cwq->thread.
@@ -901,6 +1415,98 @@ void destroy_workqueue(struct workqueue_struct *wq)
 }
 EXPORT_SYMBOL_GPL(destroy_workqueue);
 
+static void init_worker_pool(struct worker_pool *pool, int cpu)
+{
+	spin_lock_init(&pool->lock);
+	pool->cpu = cpu;
+	pool->flags = POOL_DISASSOCIATED;
+	INIT_LIST_HEAD(&pool->pending);
+	INIT_LIST_HEAD(&pool->idle_list);
+	INIT_LIST_HEAD(&pool->workers);
+	atomic_set(&pool->nr_running, 0);
+	setup_timer(&pool->idle_timer, idle_worker_timeout,
+		    (unsigned long)pool);
+	init_completion(&pool->workers_gone);
+}
+
+/* CPU_UP_PREPARE: create the first worker of the pool, not yet bound. */
+static int prepare_worker_pool(int cpu)
+{
+	struct worker_pool *pool = &per_cpu(cpu_worker_pool, cpu);
+
+	/* any workers of an earlier time online are gone */
+	pool->flags = POOL_DISASSOCIATED;
+	atomic_set(&pool->nr_running, 0);
+
+	pool->first_worker = create_worker(pool);
+	if (!pool->first_worker) {
+		printk(KERN_ERR "workqueue: no worker for cpu %d\n", cpu);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+/* CPU_ONLINE: bind the pool to the cpu and start its first worker. */
+static void bind_worker_pool(int cpu)
+{
+	struct worker_pool *pool = &per_cpu(cpu_worker_pool, cpu);
+	struct worker *worker = pool->first_worker;
+
+	kthread_bind(worker->task, cpu);
+
+	spin_lock_irq(&pool->lock);
+	pool->flags &= ~POOL_DISASSOCIATED;
+	worker->flags &= ~WORKER_UNBOUND;
+	pool->first_worker = NULL;
+	start_worker(worker);
+	spin_unlock_irq(&pool->lock);
+}
+
+/*
+ * CPU_DEAD: the workers have been moved to other cpus.  They go on with
+ * the pending cwqs as an unbound pool until CPU_POST_DEAD has flushed them.
+ */
+static void unbind_worker_pool(int cpu)
+{
+	struct worker_pool *pool = &per_cpu(cpu_worker_pool, cpu);
+	struct worker *worker;
+
+	spin_lock_irq(&pool->lock);
+	pool->flags |= POOL_DISASSOCIATED;
+	list_for_each_entry(worker, &pool->workers, node)
+		worker->flags |= WORKER_UNBOUND;
+	if (need_more_worker(pool))
+		wake_up_worker(pool);
+	spin_unlock_irq(&pool->lock);
+}
+
+/* CPU_UP_CANCELED, CPU_POST_DEAD: wait for all workers of the pool to exit. */
+static void release_worker_pool(int cpu)
+{
+	struct worker_pool *pool = &per_cpu(cpu_worker_pool, cpu);
+	struct worker *worker;
+	int wait = 0;
+
+	if (pool->first_worker) {
+		discard_worker(pool->first_worker);
+		pool->first_worker = NULL;
+	}
+
+	spin_lock_irq(&pool->lock);
+	if (pool->nr_workers) {
+		INIT_COMPLETION(pool->workers_gone);
+		pool->flags |= POOL_DYING;
+		while ((worker = first_idle_worker(pool)))
+			destroy_worker(worker);
+		wait = 1;
+	}
+	spin_unlock_irq(&pool->lock);
+
+	if (wait)
+		wait_for_completion(&pool->workers_gone);
+	del_timer_sync(&pool->idle_timer);
+}
+
 static int __devinit workqueue_cpu_callback(struct notifier_block *nfb,
 						unsigned long action,
 						void *hcpu)
@@ -914,6 +1520,8 @@ static int __devinit workqueue_cpu_callback(struct notifier_block *nfb,
 
 	switch (action) {
 	case CPU_UP_PREPARE:
+		if (prepare_worker_pool(cpu))
+			return NOTIFY_BAD;
 		cpumask_set_cpu(cpu, cpu_populated_map);
 	}
 undo:
@@ -943,8 +1551,15 @@ undo:
 	}
 
 	switch (action) {
+	case CPU_ONLINE:
+		bind_worker_pool(cpu);
+		break;
+	case CPU_DEAD:
+		unbind_worker_pool(cpu);
+		break;
 	case CPU_UP_CANCELED:
 	case CPU_POST_DEAD:
+		release_worker_pool(cpu);
 		cpumask_clear_cpu(cpu, cpu_populated_map);
 	}
 
@@ -1000,12 +1615,48 @@ EXPORT_SYMBOL_GPL(work_on_cpu);
 
 void __init init_workqueues(void)
 {
+	int cpu;
+
 	alloc_cpumask_var(&cpu_populated_map, GFP_KERNEL);
 
 	cpumask_copy(cpu_populated_map, cpu_online_mask);
 	singlethread_cpu = cpumask_first(cpu_possible_mask);
 	cpu_singlethread_map = cpumask_of(singlethread_cpu);
+
+	for_each_possible_cpu(cpu)
+		init_worker_pool(&per_cpu(cpu_worker_pool, cpu), cpu);
+	for_each_online_cpu(cpu) {
+		BUG_ON(prepare_worker_pool(cpu));
+		bind_worker_pool(cpu);
+	}
+
 	hotcpu_notifier(workqueue_cpu_callback, 0);
 	keventd_wq = create_workqueue("events");
 	BUG_ON(!keventd_wq);
 }
+
+/*
+ * Tell how many threads the workqueues created during boot would have had
+ * of their own, and how many workers serve them instead.
+ */
+static int __init report_worker_pools(void)
+{
+	struct workqueue_struct *wq;
+	int threads = 0, workers = 0, cpu;
+
+	get_online_cpus();
+	spin_lock(&workqueue_lock);
+	list_for_each_entry(wq, &workqueues, list)
+		if (!wq_has_threads(wq))
+			threads += num_online_cpus();
+	spin_unlock(&workqueue_lock);
+
+	for_each_online_cpu(cpu)
+		workers += per_cpu(cpu_worker_pool, cpu).nr_workers;
+	put_online_cpus();
+
+	printk(KERN_INFO "workqueue: %d pool workers in place of %d "
+	       "workqueue threads\n", workers, threads);
+	return 0;
+}
+late_initcall(report_worker_pools);
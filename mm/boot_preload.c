@@ -0,0 +1,519 @@
+/*
+ *	linux/mm/boot_preload.c
+ *
+ * Boot time page cache preloading.
+ *
+ * Booting reads mostly the same parts of the same files every time, but
+ * in small synchronous requests, one page fault or read() at a time and in
+ * whatever order init and zygote happen to need them.  This records those
+ * reads during one boot and replays them as large asynchronous readahead,
+ * sorted by their place on the disk, early in the next one.
+ *
+ * Recording: from boot until "stop" is written to /proc/boot_preload, or
+ * record_secs have passed, every range __do_page_cache_readahead() or a
+ * single page fault has to read is remembered per file.  Reading
+ * /proc/boot_preload then returns the trace as lines of
+ *
+ *	<first page> <number of pages> <path>
+ *
+ * which userspace keeps in a file.  Writing "clear" frees the trace.
+ *
+ * Replay: the saved trace is written back to /proc/boot_preload, by an
+ * init service ahead of zygote.  The files are opened by the writer, so
+ * paths resolve in its namespace and with its permissions.  When the file
+ * is closed, a kernel thread sorts the ranges by device and by the block
+ * bmap() returns for them, and issues them in that order through
+ * force_page_cache_readahead(), up to max_kb of page cache.  Recording
+ * goes on during a replay, and the replay's own reads are recorded too,
+ * so the ranges it read in stay in the next trace.
+ *
+ * Both sides log how long they took, measured from boot, to compare boots
+ * with and without a trace.
+ *
+ * This file is released under the GPL v2.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/file.h>
+#include <linux/hash.h>
+#include <linux/list.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/jiffies.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/seq_file.h>
+#include <linux/proc_fs.h>
+#include <linux/uaccess.h>
+#include <linux/boot_preload.h>
+
+static int record = 1;
+module_param(record, bool, S_IRUGO);
+MODULE_PARM_DESC(record, "record the reads of this boot");
+
+static unsigned int record_secs = 120;
+module_param(record_secs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(record_secs, "stop recording this long after boot");
+
+static unsigned int max_records = 8192;
+module_param(max_records, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(max_records, "maximum number of ranges recorded or replayed");
+
+static unsigned int max_kb = 32768;
+module_param(max_kb, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(max_kb, "maximum amount of page cache one replay reads in");
+
+#define BOOT_PRELOAD_HASH_SHIFT	6
+
+/**
+ * struct preload_file - a file with recorded reads
+ * @list: link into boot_preload_files, in order of first read
+ * @hash: link into boot_preload_hash
+ * @dev: device of the file
+ * @ino: inode number of the file
+ * @ranges: the recorded struct preload_range, in order of reading
+ * @path: the path the file was first read through
+ */
+struct preload_file {
+	struct list_head list;
+	struct hlist_node hash;
+	dev_t dev;
+	unsigned long ino;
+	struct list_head ranges;
+	char path[0];
+};
+
+struct preload_range {
+	struct list_head list;
+	pgoff_t start;
+	unsigned long nr;
+};
+
+/* one range of a trace being replayed */
+struct preload_req {
+	struct file *file;
+	pgoff_t start;
+	unsigned long nr;
+	sector_t block;
+	unsigned int seq;
+};
+
+/* a trace being written to /proc/boot_preload */
+struct preload_batch {
+	struct preload_req *reqs;
+	unsigned int nr;
+	unsigned int dropped;
+	struct file *last;		/* the file of the previous line */
+	char last_path[PATH_MAX];
+	size_t len;			/* of the partial line in @line */
+	char line[PATH_MAX + 48];
+};
+
+int boot_preload_recording;
+
+/* protects the trace below */
+static DEFINE_MUTEX(boot_preload_mutex);
+static LIST_HEAD(boot_preload_files);
+static struct hlist_head boot_preload_hash[1 << BOOT_PRELOAD_HASH_SHIFT];
+static unsigned int boot_preload_nr;	/* files and ranges recorded */
+
+static unsigned int boot_msecs(void)
+{
+	return jiffies_to_msecs(jiffies - INITIAL_JIFFIES);
+}
+
+static struct hlist_head *preload_hash(dev_t dev, unsigned long ino)
+{
+	return &boot_preload_hash[hash_long(ino ^ dev,
+					    BOOT_PRELOAD_HASH_SHIFT)];
+}
+
+/* the caller holds boot_preload_mutex */
+static struct preload_file *preload_file_lookup(dev_t dev, unsigned long ino)
+{
+	struct preload_file *pf;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(pf, node, preload_hash(dev, ino), hash)
+		if (pf->dev == dev && pf->ino == ino)
+			return pf;
+	return NULL;
+}
+
+static struct preload_file *preload_file_alloc(struct file *filp)
+{
+	struct inode *inode = filp->f_mapping->host;
+	struct preload_file *pf = NULL;
+	char *buf, *path;
+
+	buf = __getname();
+	if (!buf)
+		return NULL;
+	path = d_path(&filp->f_path, buf, PATH_MAX);
+	if (IS_ERR(path) || *path != '/' || strchr(path, '\n'))
+		goto out;
+
+	pf = kmalloc(sizeof(*pf) + strlen(path) + 1, GFP_KERNEL);
+	if (!pf)
+		goto out;
+	pf->dev = inode->i_sb->s_dev;
+	pf->ino = inode->i_ino;
+	INIT_LIST_HEAD(&pf->ranges);
+	strcpy(pf->path, path);
+out:
+	__putname(buf);
+	return pf;
+}
+
+/* the caller holds boot_preload_mutex */
+static void boot_preload_stop(void)
+{
+	if (!boot_preload_recording)
+		return;
+	boot_preload_recording = 0;
+	printk(KERN_INFO "boot_preload: recorded %u ranges, stopped %u ms "
+	       "after boot\n", boot_preload_nr, boot_msecs());
+}
+
+/* the caller holds boot_preload_mutex */
+static void boot_preload_clear(void)
+{
+	struct preload_file *pf, *next_pf;
+	struct preload_range *range, *next;
+
+	boot_preload_stop();
+	list_for_each_entry_safe(pf, next_pf, &boot_preload_files, list) {
+		list_for_each_entry_safe(range, next, &pf->ranges, list)
+			kfree(range);
+		hlist_del(&pf->hash);
+		kfree(pf);
+	}
+	INIT_LIST_HEAD(&boot_preload_files);
+	boot_preload_nr = 0;
+}
+
+void __boot_preload_record(struct file *filp, pgoff_t start, unsigned long nr)
+{
+	struct inode *inode = filp->f_mapping->host;
+	dev_t dev = inode->i_sb->s_dev;
+	struct preload_file *pf, *new_pf = NULL;
+	struct preload_range *range, *new_range;
+
+	new_range = kmalloc(sizeof(*new_range), GFP_KERNEL);
+	if (!new_range)
+		return;
+
+	mutex_lock(&boot_preload_mutex);
+	if (!boot_preload_recording)
+		goto out;
+	if (time_after(jiffies, INITIAL_JIFFIES + record_secs * HZ) ||
+	    boot_preload_nr + 2 > max_records) {
+		boot_preload_stop();
+		goto out;
+	}
+
+	pf = preload_file_lookup(dev, inode->i_ino);
+	if (!pf) {
+		/* d_path() and the allocation are done without the lock */
+		mutex_unlock(&boot_preload_mutex);
+		new_pf = preload_file_alloc(filp);
+		if (!new_pf) {
+			kfree(new_range);
+			return;
+		}
+		mutex_lock(&boot_preload_mutex);
+		if (!boot_preload_recording)
+			goto out;
+		pf = preload_file_lookup(dev, inode->i_ino);
+		if (!pf) {
+			pf = new_pf;
+			new_pf = NULL;
+			list_add_tail(&pf->list, &boot_preload_files);
+			hlist_add_head(&pf->hash, preload_hash(dev, pf->ino));
+			boot_preload_nr++;
+		}
+	}
+
+	/* extend the last range if this one touches it */
+	if (!list_empty(&pf->ranges)) {
+		range = list_entry(pf->ranges.prev, struct preload_range, list);
+		if (start <= range->start + range->nr &&
+		    start + nr >= range->start) {
+			unsigned long end = max(start + nr,
+						range->start + range->nr);
+
+			range->start = min(start, range->start);
+			range->nr = end - range->start;
+			goto out;
+		}
+	}
+
+	new_range->start = start;
+	new_range->nr = nr;
+	list_add_tail(&new_range->list, &pf->ranges);
+	new_range = NULL;
+	boot_preload_nr++;
+out:
+	mutex_unlock(&boot_preload_mutex);
+	kfree(new_pf);
+	kfree(new_range);
+}
+
+static int boot_preload_cmp(const void *a, const void *b)
+{
+	const struct preload_req *ra = a, *rb = b;
+	dev_t da = ra->file->f_mapping->host->i_sb->s_dev;
+	dev_t db = rb->file->f_mapping->host->i_sb->s_dev;
+
+	if (da != db)
+		return da < db ? -1 : 1;
+	if (ra->block != rb->block)
+		return ra->block < rb->block ? -1 : 1;
+	/* keep the order of the trace for those without a block */
+	return ra->seq < rb->seq ? -1 : ra->seq > rb->seq;
+}
+
+static void preload_batch_free(struct preload_batch *batch)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch->nr; i++)
+		fput(batch->reqs[i].file);
+	if (batch->last)
+		fput(batch->last);
+	vfree(batch->reqs);
+	kfree(batch);
+}
+
+static int boot_preload_replay(void *data)
+{
+	struct preload_batch *batch = data;
+	unsigned long start = jiffies;
+	unsigned long budget = max_kb >> (PAGE_SHIFT - 10);
+	unsigned long pages = 0;
+	unsigned int i;
+
+	sort(batch->reqs, batch->nr, sizeof(*batch->reqs),
+	     boot_preload_cmp, NULL);
+
+	for (i = 0; i < batch->nr; i++) {
+		struct preload_req *req = &batch->reqs[i];
+		unsigned long nr = min(req->nr, budget - pages);
+
+		if (!nr || max_sane_readahead(nr) < nr)
+			break;
+		force_page_cache_readahead(req->file->f_mapping, req->file,
+					   req->start, nr);
+		pages += nr;
+	}
+
+	printk(KERN_INFO "boot_preload: %lu pages of %u of %u ranges issued "
+	       "in %u ms, done %u ms after boot\n", pages, i, batch->nr,
+	       jiffies_to_msecs(jiffies - start), boot_msecs());
+	preload_batch_free(batch);
+	return 0;
+}
+
+/* one "<first page> <number of pages> <path>" line of a trace */
+static int preload_batch_add(struct preload_batch *batch, char *line)
+{
+	struct preload_req *req;
+	struct inode *inode;
+	unsigned long start, nr;
+	char *path;
+	int pos;
+
+	if (sscanf(line, "%lu %lu %n", &start, &nr, &pos) != 2 || !nr)
+		return -EINVAL;
+	path = line + pos;
+	if (*path != '/')
+		return -EINVAL;
+
+	if (batch->nr >= max_records) {
+		batch->dropped++;
+		return 0;
+	}
+
+	if (strcmp(path, batch->last_path)) {
+		if (batch->last)
+			fput(batch->last);
+		strlcpy(batch->last_path, path, sizeof(batch->last_path));
+		batch->last = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+		if (IS_ERR(batch->last))
+			batch->last = NULL;
+	}
+	if (!batch->last) {
+		/* gone since the trace was taken */
+		batch->dropped++;
+		return 0;
+	}
+
+	inode = batch->last->f_mapping->host;
+	req = &batch->reqs[batch->nr];
+	get_file(batch->last);
+	req->file = batch->last;
+	req->start = start;
+	req->nr = nr;
+	req->block = bmap(inode, (sector_t)start <<
+			  (PAGE_CACHE_SHIFT - inode->i_blkbits));
+	req->seq = batch->nr++;
+	return 0;
+}
+
+static int preload_batch_line(struct preload_batch *batch, char *line)
+{
+	line = strstrip(line);
+	if (!*line || *line == '#')
+		return 0;
+
+	if (!strcmp(line, "stop") || !strcmp(line, "clear")) {
+		mutex_lock(&boot_preload_mutex);
+		if (*line == 's')
+			boot_preload_stop();
+		else
+			boot_preload_clear();
+		mutex_unlock(&boot_preload_mutex);
+		return 0;
+	}
+	return preload_batch_add(batch, line);
+}
+
+static void *boot_preload_seq_start(struct seq_file *m, loff_t *pos)
+{
+	mutex_lock(&boot_preload_mutex);
+	return seq_list_start(&boot_preload_files, *pos);
+}
+
+static void *boot_preload_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	return seq_list_next(v, &boot_preload_files, pos);
+}
+
+static void boot_preload_seq_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&boot_preload_mutex);
+}
+
+static int boot_preload_seq_show(struct seq_file *m, void *v)
+{
+	struct preload_file *pf = list_entry(v, struct preload_file, list);
+	struct preload_range *range;
+
+	list_for_each_entry(range, &pf->ranges, list)
+		seq_printf(m, "%lu %lu %s\n", range->start, range->nr,
+			   pf->path);
+	return 0;
+}
+
+static const struct seq_operations boot_preload_seq_ops = {
+	.start	= boot_preload_seq_start,
+	.next	= boot_preload_seq_next,
+	.stop	= boot_preload_seq_stop,
+	.show	= boot_preload_seq_show,
+};
+
+static int boot_preload_open(struct inode *inode, struct file *filp)
+{
+	struct preload_batch *batch;
+
+	if (!(filp->f_mode & FMODE_WRITE))
+		return seq_open(filp, &boot_preload_seq_ops);
+	if (filp->f_mode & FMODE_READ)
+		return -EINVAL;
+
+	batch = kzalloc(sizeof(*batch), GFP_KERNEL);
+	if (!batch)
+		return -ENOMEM;
+	batch->reqs = vmalloc(max_records * sizeof(*batch->reqs));
+	if (!batch->reqs) {
+		kfree(batch);
+		return -ENOMEM;
+	}
+	filp->private_data = batch;
+	return nonseekable_open(inode, filp);
+}
+
+static ssize_t boot_preload_write(struct file *filp, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct preload_batch *batch = filp->private_data;
+	size_t done = 0, len;
+	char *nl;
+	int err;
+
+	while (done < count) {
+		len = min(count - done, sizeof(batch->line) - 1 - batch->len);
+		if (!len)
+			return -EINVAL;		/* line too long */
+		if (copy_from_user(batch->line + batch->len, buf + done, len))
+			return -EFAULT;
+		batch->len += len;
+		done += len;
+		batch->line[batch->len] = '\0';
+
+		while ((nl = strchr(batch->line, '\n'))) {
+			*nl++ = '\0';
+			err = preload_batch_line(batch, batch->line);
+			if (err)
+				return err;
+			batch->len -= nl - batch->line;
+			memmove(batch->line, nl, batch->len + 1);
+		}
+	}
+	return count;
+}
+
+static int boot_preload_release(struct inode *inode, struct file *filp)
+{
+	struct preload_batch *batch = filp->private_data;
+	struct task_struct *task;
+
+	if (!(filp->f_mode & FMODE_WRITE))
+		return seq_release(inode, filp);
+
+	/* the last line may lack its newline */
+	if (batch->len)
+		preload_batch_line(batch, batch->line);
+	if (batch->dropped)
+		printk(KERN_INFO "boot_preload: %u ranges not replayed\n",
+		       batch->dropped);
+	if (batch->last) {
+		fput(batch->last);
+		batch->last = NULL;
+	}
+
+	if (!batch->nr) {
+		preload_batch_free(batch);
+		return 0;
+	}
+	task = kthread_run(boot_preload_replay, batch, "bootpreload");
+	if (IS_ERR(task))
+		boot_preload_replay(batch);
+	return 0;
+}
+
+static const struct file_operations boot_preload_fops = {
+	.owner		= THIS_MODULE,
+	.open		= boot_preload_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.write		= boot_preload_write,
+	.release	= boot_preload_release,
+};
+
+static int __init boot_preload_init(void)
+{
+	if (!proc_create("boot_preload", S_IRUSR | S_IWUSR, NULL,
+			 &boot_preload_fops))
+		return -ENOMEM;
+	boot_preload_recording = record;
+	return 0;
+}
+module_init(boot_preload_init)
@@ -0,0 +1,339 @@
+/*
+ *	linux/mm/ccache.c
+ *
+ * Compressed cache for clean page cache pages.
+ *
+ * Without swap, vmscan can only drop clean file pages, and the next access
+ * reads them back from flash.  shrink_page_list() calls ccache_put() just
+ * before a clean page leaves the page cache: the page is LZO-compressed
+ * into an xvmalloc pool and indexed in the ccache_tree of its mapping.
+ * When the page is added to the page cache again, ccache_get() decompresses
+ * it into the new page and marks it uptodate, so no ->readpage is issued.
+ *
+ * A compressed copy only exists while its page is not in the page cache,
+ * so writes through the page cache never leave it stale: only truncate,
+ * direct I/O and the inode going away have to drop copies.  The pool is
+ * bounded by vm.ccache_max_pages, the oldest copies are dropped first.
+ *
+ * Only filesystems on a device are cached: the data of a network
+ * filesystem may change on the server while no page is cached to notice.
+ *
+ * This file is released under the GPL v2.
+ */
+
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/highmem.h>
+#include <linux/pagemap.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
+#include <linux/radix-tree.h>
+#include <linux/vmstat.h>
+#include <linux/lzo.h>
+#include <linux/ccache.h>
+
+#include "../drivers/staging/ramzswap/xvmalloc.h"
+
+/*
+ * We are called from reclaim, so the pool must not recurse into it nor
+ * dip into the emergency reserves.
+ */
+#define CCACHE_GFP	(__GFP_HIGHMEM | __GFP_NOMEMALLOC | __GFP_NOWARN)
+
+/* Slab and radix tree nodes can't come from highmem */
+#define CCACHE_SLAB_GFP	(CCACHE_GFP & ~__GFP_HIGHMEM)
+
+/* A page which does not compress better than this is not kept */
+#define CCACHE_MAX_LEN	(PAGE_SIZE * 3 / 4)
+
+/**
+ * struct ccache_entry - compressed copy of one page cache page
+ * @lru: link into ccache_lru, most recently stored first
+ * @mapping: the address_space the page was evicted from
+ * @index: the page index in @mapping
+ * @page: the pool page holding the compressed data
+ * @offset: offset of the compressed data in @page
+ * @len: length of the compressed data
+ */
+struct ccache_entry {
+	struct list_head lru;
+	struct address_space *mapping;
+	pgoff_t index;
+	struct page *page;
+	u16 offset;
+	u16 len;
+};
+
+/* protects ccache_lru, the ccache_tree of all mappings and the pool */
+static DEFINE_SPINLOCK(ccache_lock);
+static LIST_HEAD(ccache_lru);
+static struct xv_pool *ccache_pool;
+static struct kmem_cache *ccache_entry_cache;
+
+/* Upper bound of the pool size, in pages; 0 stops storing */
+unsigned long ccache_max_pages;
+
+static DEFINE_PER_CPU(void *, ccache_wrkmem);
+static DEFINE_PER_CPU(void *, ccache_buf);
+
+static int ccache_mapping_ok(struct address_space *mapping)
+{
+	struct inode *host = mapping->host;
+
+	return host && host->i_sb &&
+		(host->i_sb->s_type->fs_flags & FS_REQUIRES_DEV) &&
+		!mapping_unevictable(mapping);
+}
+
+/*
+ * Account the pool pages allocated or freed since the pool was @old_size
+ * to the zone of @page, which is where xvmalloc put the object.
+ * The caller holds ccache_lock.
+ */
+static void ccache_account_pool(struct page *page, u64 old_size)
+{
+	long delta;
+
+	delta = (long)(xv_get_total_size_bytes(ccache_pool) >> PAGE_SHIFT) -
+		(long)(old_size >> PAGE_SHIFT);
+	if (delta)
+		mod_zone_page_state(page_zone(page), NR_CCACHE_POOL, delta);
+}
+
+/* the caller holds ccache_lock */
+static void ccache_remove(struct ccache_entry *entry)
+{
+	radix_tree_delete(&entry->mapping->ccache_tree, entry->index);
+	list_del(&entry->lru);
+}
+
+/* the caller holds ccache_lock */
+static void ccache_free(struct ccache_entry *entry)
+{
+	u64 size = xv_get_total_size_bytes(ccache_pool);
+
+	dec_zone_page_state(entry->page, NR_CCACHE_PAGES);
+	xv_free(ccache_pool, entry->page, entry->offset);
+	ccache_account_pool(entry->page, size);
+	kmem_cache_free(ccache_entry_cache, entry);
+}
+
+/* drop the oldest copies until the pool fits; the caller holds ccache_lock */
+static void ccache_shrink(void)
+{
+	struct ccache_entry *entry;
+	u64 max_size = (u64)ccache_max_pages << PAGE_SHIFT;
+
+	while (xv_get_total_size_bytes(ccache_pool) > max_size &&
+	       !list_empty(&ccache_lru)) {
+		entry = list_entry(ccache_lru.prev, struct ccache_entry, lru);
+		ccache_remove(entry);
+		ccache_free(entry);
+		count_vm_event(CCACHE_EVICT);
+	}
+}
+
+/**
+ * ccache_put - keep a compressed copy of a page leaving the page cache
+ * @mapping: the address_space @page is in
+ * @page: the locked, clean, uptodate and unmapped page about to be removed
+ *
+ * Returns 0 if a copy was stored.  The caller must drop it again with
+ * ccache_invalidate_page() if the page then stays in the page cache.
+ */
+int ccache_put(struct address_space *mapping, struct page *page)
+{
+	struct ccache_entry *entry, *old;
+	struct page *obj_page;
+	unsigned char *src, *dst, *buf;
+	size_t clen;
+	u32 offset;
+	u64 size;
+	int err;
+
+	if (!ccache_pool || !ccache_max_pages)
+		return -ENOSYS;
+	/* the page cache and our isolation reference, nothing else */
+	if (PageDirty(page) || PageSwapBacked(page) || page_count(page) != 2 ||
+	    !ccache_mapping_ok(mapping))
+		return -EBUSY;
+	/* a failed or partial read must not come back as uptodate */
+	if (!PageUptodate(page) || PageError(page))
+		return -EBUSY;
+	/* truncate is under way, nothing past EOF may come back */
+	if (page->index >= (i_size_read(mapping->host) + PAGE_CACHE_SIZE - 1) >>
+			   PAGE_CACHE_SHIFT)
+		return -EBUSY;
+
+	err = -ENOMEM;
+	entry = kmem_cache_alloc(ccache_entry_cache, CCACHE_SLAB_GFP);
+	if (!entry)
+		goto out_reject;
+
+	buf = get_cpu_var(ccache_buf);
+	src = kmap_atomic(page, KM_USER0);
+	err = lzo1x_1_compress(src, PAGE_SIZE, buf, &clen,
+			       __get_cpu_var(ccache_wrkmem));
+	kunmap_atomic(src, KM_USER0);
+	if (err != LZO_E_OK || clen > CCACHE_MAX_LEN) {
+		err = -E2BIG;
+		goto out_put_cpu;
+	}
+
+	err = radix_tree_preload(CCACHE_SLAB_GFP);
+	if (err)
+		goto out_put_cpu;
+
+	spin_lock(&ccache_lock);
+	size = xv_get_total_size_bytes(ccache_pool);
+	err = xv_malloc(ccache_pool, clen, &obj_page, &offset, CCACHE_GFP);
+	if (err)
+		goto out_unlock;
+	ccache_account_pool(obj_page, size);
+
+	dst = kmap_atomic(obj_page, KM_USER0);
+	memcpy(dst + offset, buf, clen);
+	kunmap_atomic(dst, KM_USER0);
+
+	entry->mapping = mapping;
+	entry->index = page->index;
+	entry->page = obj_page;
+	entry->offset = offset;
+	entry->len = clen;
+
+	old = radix_tree_lookup(&mapping->ccache_tree, page->index);
+	if (old) {
+		ccache_remove(old);
+		ccache_free(old);
+	}
+	err = radix_tree_insert(&mapping->ccache_tree, page->index, entry);
+	if (unlikely(err)) {
+		xv_free(ccache_pool, obj_page, offset);
+		ccache_account_pool(obj_page, size);
+		goto out_unlock;
+	}
+	list_add(&entry->lru, &ccache_lru);
+	inc_zone_page_state(obj_page, NR_CCACHE_PAGES);
+	ccache_shrink();
+	spin_unlock(&ccache_lock);
+
+	radix_tree_preload_end();
+	put_cpu_var(ccache_buf);
+	count_vm_event(CCACHE_STORE);
+	return 0;
+
+out_unlock:
+	spin_unlock(&ccache_lock);
+	radix_tree_preload_end();
+out_put_cpu:
+	put_cpu_var(ccache_buf);
+	kmem_cache_free(ccache_entry_cache, entry);
+out_reject:
+	count_vm_event(CCACHE_REJECT);
+	return err;
+}
+
+void __ccache_get(struct address_space *mapping, struct page *page)
+{
+	struct ccache_entry *entry;
+	unsigned char *src, *dst;
+	size_t len = PAGE_SIZE;
+	int err;
+
+	spin_lock(&ccache_lock);
+	entry = radix_tree_lookup(&mapping->ccache_tree, page->index);
+	if (entry)
+		ccache_remove(entry);
+	spin_unlock(&ccache_lock);
+	if (!entry)
+		return;
+
+	/* unlinked, nobody else can free it meanwhile */
+	if (!PageUptodate(page)) {
+		src = kmap_atomic(entry->page, KM_USER0);
+		dst = kmap_atomic(page, KM_USER1);
+		err = lzo1x_decompress_safe(src + entry->offset, entry->len,
+					    dst, &len);
+		kunmap_atomic(dst, KM_USER1);
+		kunmap_atomic(src, KM_USER0);
+		if (err == LZO_E_OK && len == PAGE_SIZE) {
+			flush_dcache_page(page);
+			SetPageUptodate(page);
+			count_vm_event(CCACHE_HIT);
+		}
+	}
+
+	spin_lock(&ccache_lock);
+	ccache_free(entry);
+	spin_unlock(&ccache_lock);
+}
+
+void __ccache_invalidate_range(struct address_space *mapping,
+			       pgoff_t start, pgoff_t end)
+{
+	struct ccache_entry *entries[16];
+	unsigned int i, nr;
+
+	spin_lock(&ccache_lock);
+	while (start <= end) {
+		nr = radix_tree_gang_lookup(&mapping->ccache_tree,
+					    (void **)entries, start,
+					    ARRAY_SIZE(entries));
+		if (!nr)
+			break;
+		for (i = 0; i < nr; i++) {
+			if (entries[i]->index > end)
+				goto out;
+			start = entries[i]->index + 1;
+			ccache_remove(entries[i]);
+			ccache_free(entries[i]);
+			count_vm_event(CCACHE_INVALIDATE);
+		}
+		if (!start)	/* wrapped */
+			break;
+	}
+out:
+	spin_unlock(&ccache_lock);
+}
+
+static int __init ccache_init(void)
+{
+	struct xv_pool *pool;
+	int cpu;
+
+	ccache_entry_cache = KMEM_CACHE(ccache_entry, 0);
+	if (!ccache_entry_cache)
+		goto out;
+
+	for_each_possible_cpu(cpu) {
+		per_cpu(ccache_wrkmem, cpu) = kmalloc(LZO1X_MEM_COMPRESS,
+						      GFP_KERNEL);
+		/* LZO may expand incompressible data a little */
+		per_cpu(ccache_buf, cpu) = (void *)__get_free_pages(GFP_KERNEL,
+								    1);
+		if (!per_cpu(ccache_wrkmem, cpu) || !per_cpu(ccache_buf, cpu))
+			goto out_free;
+	}
+
+	pool = xv_create_pool();
+	if (!pool)
+		goto out_free;
+
+	ccache_max_pages = totalram_pages / 16;
+	ccache_pool = pool;
+	return 0;
+
+out_free:
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(ccache_wrkmem, cpu));
+		free_pages((unsigned long)per_cpu(ccache_buf, cpu), 1);
+	}
+	kmem_cache_destroy(ccache_entry_cache);
+out:
+	printk(KERN_ERR "ccache: initialization failed\n");
+	return -ENOMEM;
+}
+module_init(ccache_init)
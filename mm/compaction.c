@@ -0,0 +1,397 @@
+/*
+ *	linux/mm/compaction.c
+ *
+ * Memory compaction for the reduction of external fragmentation.
+ *
+ * After a long uptime most free memory is in order-0 and order-1 blocks,
+ * and allocations of a few contiguous pages by drivers start failing
+ * although plenty of memory is free.  Compaction walks a zone with two
+ * scanners: one from the start isolates movable LRU pages, the other from
+ * the end isolates free pages, and the pages found by the first are
+ * migrated into those found by the second.  The start of the zone is left
+ * with large free blocks.
+ *
+ * kcompactd runs it in the background: the page allocator wakes it when
+ * an allocation of order > 0 misses the low watermark.  Each zone whose
+ * fragmentation index for that order is above vm.extfrag_threshold, that
+ * is, where free memory is there but too scattered, is compacted until it
+ * meets the watermark for the order again.  Writing to vm.compact_memory
+ * compacts all zones completely.
+ *
+ * This file is released under the GPL v2.
+ */
+
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/migrate.h>
+#include <linux/mm_inline.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/init.h>
+#include <linux/vmstat.h>
+#include <linux/compaction.h>
+#include "internal.h"
+
+/* pages isolated for migration at a time */
+#define COMPACT_CLUSTER_MAX	SWAP_CLUSTER_MAX
+
+/* Return values of compact_finished() */
+#define COMPACT_CONTINUE	0	/* keep going */
+#define COMPACT_PARTIAL		1	/* the order is available again */
+#define COMPACT_COMPLETE	2	/* the scanners met */
+
+/*
+ * compact_control is used to track pages being migrated and the free pages
+ * they are being migrated to during memory compaction.  The free_pfn starts
+ * at the end of a zone and migrate_pfn begins at the start.  Movable pages
+ * are moved to the end of a zone during a compaction run and the run
+ * completes when free_pfn <= migrate_pfn.
+ */
+struct compact_control {
+	struct list_head freepages;	/* List of free pages to migrate to */
+	struct list_head migratepages;	/* List of pages being migrated */
+	unsigned long nr_freepages;	/* Number of isolated free pages */
+	unsigned long nr_migratepages;	/* Number of pages to migrate */
+	unsigned long free_pfn;		/* isolate_freepages search base */
+	unsigned long migrate_pfn;	/* isolate_migratepages search base */
+	int order;			/* order to compact for, -1 for all */
+	struct zone *zone;
+};
+
+int sysctl_compact_memory;
+int sysctl_extfrag_threshold = 500;
+
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+static struct task_struct *kcompactd_task;
+static int kcompactd_order;	/* highest order asked for since the last pass */
+
+static unsigned long release_freepages(struct list_head *freelist)
+{
+	struct page *page, *next;
+	unsigned long count = 0;
+
+	list_for_each_entry_safe(page, next, freelist, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+		count++;
+	}
+	return count;
+}
+
+/*
+ * Isolate the free pages of the pageblock at @blockpfn.
+ * Called with zone->lock held.
+ */
+static unsigned long isolate_freepages_block(struct zone *zone,
+				unsigned long blockpfn,
+				struct list_head *freelist)
+{
+	unsigned long zone_end_pfn, end_pfn;
+	unsigned long total_isolated = 0;
+
+	zone_end_pfn = zone->zone_start_pfn + zone->spanned_pages;
+	end_pfn = min(blockpfn + pageblock_nr_pages, zone_end_pfn);
+
+	for (; blockpfn < end_pfn; blockpfn++) {
+		struct page *page;
+		int isolated, i;
+
+		if (!pfn_valid_within(blockpfn))
+			continue;
+		page = pfn_to_page(blockpfn);
+		if (!PageBuddy(page))
+			continue;
+
+		isolated = split_free_page(page);
+		total_isolated += isolated;
+		for (i = 0; i < isolated; i++) {
+			list_add(&page->lru, freelist);
+			page++;
+		}
+		if (isolated)
+			blockpfn += isolated - 1;
+	}
+	return total_isolated;
+}
+
+/* Only pageblocks of movable pages are taken apart for their free pages */
+static int suitable_migration_target(struct page *page)
+{
+	int migratetype = get_pageblock_migratetype(page);
+
+	if (migratetype == MIGRATE_ISOLATE || migratetype == MIGRATE_RESERVE)
+		return 0;
+	if (PageBuddy(page) && page_order(page) >= pageblock_order)
+		return 1;
+	return migratetype == MIGRATE_MOVABLE;
+}
+
+/*
+ * Isolate free pages from the end of the zone, one pageblock at a time,
+ * until there are as many as pages to migrate.
+ */
+static void isolate_freepages(struct zone *zone, struct compact_control *cc)
+{
+	struct page *page;
+	unsigned long high_pfn, low_pfn, pfn;
+	unsigned long nr_freepages = cc->nr_freepages;
+	unsigned long flags;
+
+	pfn = cc->free_pfn;
+	low_pfn = cc->migrate_pfn + pageblock_nr_pages;
+	high_pfn = low_pfn;
+
+	for (; pfn > low_pfn && cc->nr_migratepages > nr_freepages;
+	     pfn -= pageblock_nr_pages) {
+		unsigned long isolated = 0;
+
+		if (!pfn_valid(pfn))
+			continue;
+		page = pfn_to_page(pfn);
+		if (page_zone(page) != zone)
+			continue;
+		if (!suitable_migration_target(page))
+			continue;
+
+		spin_lock_irqsave(&zone->lock, flags);
+		if (suitable_migration_target(page)) {
+			isolated = isolate_freepages_block(zone, pfn,
+							   &cc->freepages);
+			nr_freepages += isolated;
+		}
+		spin_unlock_irqrestore(&zone->lock, flags);
+
+		/* start there next time, migration may free more of it */
+		if (isolated)
+			high_pfn = max(high_pfn, pfn);
+	}
+
+	list_for_each_entry(page, &cc->freepages, lru) {
+		arch_alloc_page(page, 0);
+		kernel_map_pages(page, 1, 1);
+	}
+
+	cc->free_pfn = high_pfn;
+	cc->nr_freepages = nr_freepages;
+}
+
+/*
+ * Isolate up to COMPACT_CLUSTER_MAX movable pages from the LRU, going on
+ * from where the last call stopped.  Returns the number isolated.
+ */
+static unsigned long isolate_migratepages(struct zone *zone,
+					  struct compact_control *cc)
+{
+	unsigned long low_pfn, end_pfn;
+
+	low_pfn = max(cc->migrate_pfn, zone->zone_start_pfn);
+	end_pfn = ALIGN(low_pfn + pageblock_nr_pages, pageblock_nr_pages);
+
+	/* the free scanner is there already, or this is a hole */
+	if (end_pfn > cc->free_pfn || !pfn_valid(low_pfn)) {
+		cc->migrate_pfn = end_pfn;
+		return 0;
+	}
+
+	cond_resched();
+	spin_lock_irq(&zone->lru_lock);
+	for (; low_pfn < end_pfn; low_pfn++) {
+		struct page *page;
+
+		if (!pfn_valid_within(low_pfn))
+			continue;
+		page = pfn_to_page(low_pfn);
+		if (PageBuddy(page))
+			continue;
+		if (__isolate_lru_page(page, ISOLATE_BOTH, 0))
+			continue;
+
+		/* __isolate_lru_page() took it off the memcg LRU already */
+		__dec_zone_state(zone, NR_LRU_BASE + page_lru(page));
+		list_move(&page->lru, &cc->migratepages);
+		if (++cc->nr_migratepages == COMPACT_CLUSTER_MAX)
+			break;
+	}
+	spin_unlock_irq(&zone->lru_lock);
+
+	cc->migrate_pfn = low_pfn;
+	return cc->nr_migratepages;
+}
+
+/* new_page_t for migrate_pages(): hand out the isolated free pages */
+static struct page *compaction_alloc(struct page *migratepage,
+				     unsigned long data, int **result)
+{
+	struct compact_control *cc = (struct compact_control *)data;
+	struct page *freepage;
+
+	if (list_empty(&cc->freepages)) {
+		isolate_freepages(cc->zone, cc);
+		if (list_empty(&cc->freepages))
+			return NULL;
+	}
+
+	freepage = list_entry(cc->freepages.next, struct page, lru);
+	list_del(&freepage->lru);
+	cc->nr_freepages--;
+	return freepage;
+}
+
+static int compact_finished(struct zone *zone, struct compact_control *cc)
+{
+	if (fatal_signal_pending(current))
+		return COMPACT_PARTIAL;
+	if (cc->free_pfn <= cc->migrate_pfn)
+		return COMPACT_COMPLETE;
+	if (cc->order < 0)
+		return COMPACT_CONTINUE;
+	if (zone_watermark_ok(zone, cc->order, zone->pages_low, 0, 0))
+		return COMPACT_PARTIAL;
+	return COMPACT_CONTINUE;
+}
+
+static int compact_zone(struct zone *zone, struct compact_control *cc)
+{
+	unsigned long nr_migrate;
+	int ret, failed;
+
+	cc->migrate_pfn = zone->zone_start_pfn;
+	cc->free_pfn = cc->migrate_pfn + zone->spanned_pages;
+	cc->free_pfn &= ~(pageblock_nr_pages - 1);
+
+	migrate_prep();
+
+	while ((ret = compact_finished(zone, cc)) == COMPACT_CONTINUE) {
+		if (!isolate_migratepages(zone, cc))
+			continue;
+
+		nr_migrate = cc->nr_migratepages;
+		/* puts back whatever it could not move */
+		failed = migrate_pages(&cc->migratepages, compaction_alloc,
+				       (unsigned long)cc);
+		if (failed < 0)
+			failed = nr_migrate;
+		cc->nr_migratepages = 0;
+
+		count_vm_event(COMPACTBLOCKS);
+		count_vm_events(COMPACTPAGES, nr_migrate - failed);
+		if (failed)
+			count_vm_events(COMPACTPAGEFAILED, failed);
+	}
+
+	cc->nr_freepages -= release_freepages(&cc->freepages);
+	VM_BUG_ON(cc->nr_freepages);
+	return ret;
+}
+
+static int compact_zone_order(struct zone *zone, int order)
+{
+	struct compact_control cc = {
+		.nr_freepages = 0,
+		.nr_migratepages = 0,
+		.order = order,
+		.zone = zone,
+	};
+
+	INIT_LIST_HEAD(&cc.freepages);
+	INIT_LIST_HEAD(&cc.migratepages);
+	return compact_zone(zone, &cc);
+}
+
+/*
+ * Compaction helps an allocation of @order in @zone if the zone misses
+ * the watermark for the order, yet has the free pages to migrate into,
+ * and these are scattered rather than just too few.
+ */
+static int compaction_suitable(struct zone *zone, int order)
+{
+	int index;
+
+	if (zone_watermark_ok(zone, order, zone->pages_low, 0, 0))
+		return 0;
+	if (!zone_watermark_ok(zone, 0, zone->pages_low + (2UL << order),
+			       0, 0))
+		return 0;
+
+	index = fragmentation_index(zone, order);
+	return index < 0 || index > sysctl_extfrag_threshold;
+}
+
+/**
+ * wakeup_kcompactd - ask for compaction in the background
+ * @order: order of the allocation which missed the low watermark
+ */
+void wakeup_kcompactd(int order)
+{
+	if (!kcompactd_task || order <= kcompactd_order)
+		return;
+	kcompactd_order = order;
+	if (waitqueue_active(&kcompactd_wait))
+		wake_up_interruptible(&kcompactd_wait);
+}
+
+static int kcompactd(void *unused)
+{
+	struct zone *zone;
+	int order;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(kcompactd_wait,
+				     kcompactd_order || kthread_should_stop());
+
+		/* a wakeup racing with this is lost, the next one comes soon */
+		order = kcompactd_order;
+		kcompactd_order = 0;
+		if (!order)
+			continue;
+
+		for_each_zone(zone) {
+			if (!populated_zone(zone))
+				continue;
+			if (compaction_suitable(zone, order))
+				compact_zone_order(zone, order);
+		}
+
+		/* let the allocations use the blocks before looking again */
+		schedule_timeout_interruptible(HZ / 10);
+	}
+	return 0;
+}
+
+/* Compact all zones completely */
+static void compact_nodes(void)
+{
+	struct zone *zone;
+
+	for_each_zone(zone) {
+		if (!populated_zone(zone))
+			continue;
+		compact_zone_order(zone, -1);
+	}
+}
+
+int sysctl_compaction_handler(struct ctl_table *table, int write,
+			struct file *file, void __user *buffer,
+			size_t *length, loff_t *ppos)
+{
+	if (write)
+		compact_nodes();
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(kcompactd, NULL, "kcompactd");
+	if (IS_ERR(task)) {
+		printk(KERN_ERR "kcompactd: unable to start\n");
+		return PTR_ERR(task);
+	}
+	kcompactd_task = task;
+	return 0;
+}
+module_init(kcompactd_init)
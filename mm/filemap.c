@@ -33,6 +33,9 @@
 #include <linux/cpuset.h>
 #include <linux/hardirq.h> /* for BUG_ON(!in_atomic()) only */
 #include <linux/memcontrol.h>
+#include <linux/ccache.h>
+#include <linux/workingset.h>
+#include <linux/boot_preload.h>
 #include <linux/mm_inline.h> /* for page_is_file_cache() */
 #include "internal.h"
 
@@ -442,19 +445,11 @@ int filemap_write_and_wait_range(struct address_space *mapping,
 	return err;
 }
 
-/**
- * add_to_page_cache_locked - add a locked page to the pagecache
- * @page:	page to add
- * @mapping:	the page's address_space
- * @offset:	page index
- * @gfp_mask:	page allocation mode
- *
- * This function is used to add a page to the pagecache. It must be locked.
- * This function does not add the page to the LRU.  The caller must do that.
- */
-int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
-		pgoff_t offset, gfp_t gfp_mask)
+static int __add_to_page_cache_locked(struct page *page,
+		struct address_space *mapping, pgoff_t offset, gfp_t gfp_mask,
+		void **shadowp)
 {
+	void *shadow;
 	int error;
 
 	VM_BUG_ON(!PageLocked(page));
@@ -475,6 +470,9 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 		if (likely(!error)) {
 			mapping->nrpages++;
 			__inc_zone_page_state(page, NR_FILE_PAGES);
+			shadow = workingset_take_shadow(mapping, offset);
+			if (shadowp)
+				*shadowp = shadow;
 		} else {
 			page->mapping = NULL;
 			mem_cgroup_uncharge_cache_page(page);
@@ -483,16 +481,36 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 
 		spin_unlock_irq(&mapping->tree_lock);
 		radix_tree_preload_end();
+		if (likely(!error))
+			ccache_get(mapping, page);
 	} else
 		mem_cgroup_uncharge_cache_page(page);
 out:
 	return error;
 }
+
+/**
+ * add_to_page_cache_locked - add a locked page to the pagecache
+ * @page:	page to add
+ * @mapping:	the page's address_space
+ * @offset:	page index
+ * @gfp_mask:	page allocation mode
+ *
+ * This function is used to add a page to the pagecache. It must be locked.
+ * This function does not add the page to the LRU.  The caller must do that.
+ * The page may come back uptodate, filled from the compressed cache.
+ */
+int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
+		pgoff_t offset, gfp_t gfp_mask)
+{
+	return __add_to_page_cache_locked(page, mapping, offset, gfp_mask, NULL);
+}
 EXPORT_SYMBOL(add_to_page_cache_locked);
 
 int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				pgoff_t offset, gfp_t gfp_mask)
 {
+	void *shadow = NULL;
 	int ret;
 
 	/*
@@ -504,14 +522,23 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 	if (mapping_cap_swap_backed(mapping))
 		SetPageSwapBacked(page);
 
-	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
-	if (ret == 0) {
-		if (page_is_file_cache(page))
-			lru_cache_add_file(page);
-		else
-			lru_cache_add_active_anon(page);
+	__set_page_locked(page);
+	ret = __add_to_page_cache_locked(page, mapping, offset, gfp_mask,
+					 &shadow);
+	if (unlikely(ret)) {
+		__clear_page_locked(page);
+		return ret;
 	}
-	return ret;
+
+	if (!page_is_file_cache(page))
+		lru_cache_add_active_anon(page);
+	else if (shadow && workingset_refault(shadow)) {
+		/* evicted too early: part of the working set */
+		workingset_activation(page);
+		lru_cache_add_active_file(page);
+	} else
+		lru_cache_add_file(page);
+	return 0;
 }
 
 #ifdef CONFIG_NUMA
@@ -786,7 +813,7 @@ unsigned find_get_pages(struct address_space *mapping, pgoff_t start,
 	rcu_read_lock();
 restart:
 	nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
-				(void ***)pages, start, nr_pages);
+				(void ***)pages, NULL, start, nr_pages);
 	ret = 0;
 	for (i = 0; i < nr_found; i++) {
 		struct page *page;
@@ -839,7 +866,7 @@ unsigned find_get_pages_contig(struct address_space *mapping, pgoff_t index,
 	rcu_read_lock();
 restart:
 	nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
-				(void ***)pages, index, nr_pages);
+				(void ***)pages, NULL, index, nr_pages);
 	ret = 0;
 	for (i = 0; i < nr_found; i++) {
 		struct page *page;
@@ -1138,7 +1165,6 @@ page_not_up_to_date_locked:
 			goto page_ok;
 		}
 
-readpage:
 		/* Start the actual read. The read will unlock the page. */
 		error = mapping->a_ops->readpage(filp, page);
 
@@ -1198,7 +1224,7 @@ no_cached_page:
 			desc->error = error;
 			goto out;
 		}
-		goto readpage;
+		goto page_not_up_to_date_locked;
 	}
 
 out:
@@ -1422,9 +1448,14 @@ static int page_cache_read(struct file *file, pgoff_t offset)
 			return -ENOMEM;
 
 		ret = add_to_page_cache_lru(page, mapping, offset, GFP_KERNEL);
-		if (ret == 0)
-			ret = mapping->a_ops->readpage(file, page);
-		else if (ret == -EEXIST)
+		if (ret == 0) {
+			if (PageUptodate(page))
+				unlock_page(page);
+			else {
+				boot_preload_record(file, offset, 1);
+				ret = mapping->a_ops->readpage(file, page);
+			}
+		} else if (ret == -EEXIST)
 			ret = 0; /* losing race to add is OK */
 
 		page_cache_release(page);
@@ -1492,15 +1523,29 @@ retry_find:
 
 	if (!page) {
 		unsigned long ra_pages;
+		pgoff_t start = 0;
 
 		ra->mmap_miss++;
+		if (!did_readaround)
+			page_cache_fault_history(mapping, ra, file, vmf->pgoff);
 
 		/*
 		 * Do we miss much more than hit in this file? If so,
 		 * stop bothering with read-ahead. It will only hurt.
+		 * Unless clustering is configured: then just read the
+		 * aligned cluster around the fault, flash much prefers
+		 * a few larger reads to many single pages.
 		 */
-		if (ra->mmap_miss > MMAP_LOTSAMISS)
-			goto no_cached_page;
+		if (ra->mmap_miss > MMAP_LOTSAMISS) {
+			ra_pages = VM_CLUSTER_READAHEAD * 1024 / PAGE_CACHE_SIZE;
+			if (!ra_pages)
+				goto no_cached_page;
+			start = vmf->pgoff & ~(ra_pages - 1);
+		} else {
+			ra_pages = max_sane_readahead(file->f_ra.ra_pages);
+			if (vmf->pgoff > ra_pages / 2)
+				start = vmf->pgoff - ra_pages / 2;
+		}
 
 		/*
 		 * To keep the pgmajfault counter straight, we need to
@@ -1511,14 +1556,8 @@ retry_find:
 			count_vm_event(PGMAJFAULT);
 		}
 		did_readaround = 1;
-		ra_pages = max_sane_readahead(file->f_ra.ra_pages);
-		if (ra_pages) {
-			pgoff_t start = 0;
-
-			if (vmf->pgoff > ra_pages / 2)
-				start = vmf->pgoff - ra_pages / 2;
+		if (ra_pages)
 			do_page_cache_readahead(mapping, file, start, ra_pages);
-		}
 		page = find_lock_page(mapping, vmf->pgoff);
 		if (!page)
 			goto no_cached_page;
@@ -1666,6 +1705,10 @@ repeat:
 			/* Presumably ENOMEM for radix tree node */
 			return ERR_PTR(err);
 		}
+		if (PageUptodate(page)) {
+			unlock_page(page);
+			return page;
+		}
 		err = filler(data, page);
 		if (err < 0) {
 			page_cache_release(page);
@@ -2087,6 +2130,7 @@ generic_file_direct_write(struct kiocb *iocb, const struct iovec *iov,
 	 * about to write.  We do this *before* the write so that we can return
 	 * without clobbering -EIOCBQUEUED from ->direct_IO().
 	 */
+	ccache_invalidate_range(mapping, pos >> PAGE_CACHE_SHIFT, end);
 	if (mapping->nrpages) {
 		written = invalidate_inode_pages2_range(mapping,
 					pos >> PAGE_CACHE_SHIFT, end);
@@ -2111,6 +2155,7 @@ generic_file_direct_write(struct kiocb *iocb, const struct iovec *iov,
 	 * so we don't support it 100%.  If this invalidation
 	 * fails, tough, the write still worked...
 	 */
+	ccache_invalidate_range(mapping, pos >> PAGE_CACHE_SHIFT, end);
 	if (mapping->nrpages) {
 		invalidate_inode_pages2_range(mapping,
 					      pos >> PAGE_CACHE_SHIFT, end);
@@ -51,6 +51,12 @@ extern void putback_lru_page(struct page *page);
  */
 extern unsigned long highest_memmap_pfn;
 extern void __free_pages_bootmem(struct page *page, unsigned int order);
+extern int split_free_page(struct page *page);
+
+/*
+ * in mm/vmstat.c
+ */
+extern int fragmentation_index(struct zone *zone, unsigned int order);
 
 /*
  * function for dealing with page's order in buddy system.
@@ -0,0 +1,295 @@
+/*
+ *	linux/mm/mem_notify.c
+ *
+ * Memory pressure notification for userspace.
+ *
+ * shrink_zone() reports how many pages it scanned and how many of them it
+ * could free.  Over a window of scanned pages that gives the reclaim
+ * efficiency, which is turned into a pressure level:
+ *
+ *   low       reclaim is running, most pages are still freed
+ *   medium    more than mem_notify.medium percent of them cannot be freed
+ *   critical  more than mem_notify.critical percent cannot be freed, or
+ *             reclaim is scanning at a high priority already
+ *
+ * Each level change is an event with a sequence number, kept in a small
+ * ring.  The same level is posted again at most once per ratelimit_ms, a
+ * higher one is posted at once.
+ *
+ * Readers open /dev/mem_notify and poll() it.  read() returns the events
+ * in order, one per call, as "<level> <seq> <age in ms>\n".  Writing
+ * "low", "medium" or "critical" sets the lowest level the file reports;
+ * it is "low" by default.  A reader which falls behind by more than the
+ * ring size skips to the oldest event still kept.
+ *
+ * This file is released under the GPL v2.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/jiffies.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/swap.h>
+#include <linux/miscdevice.h>
+#include <linux/mem_notify.h>
+
+/* pages to scan before the reclaim efficiency is sampled */
+#define MEM_NOTIFY_WINDOW	(SWAP_CLUSTER_MAX * 16)
+
+#define MEM_NOTIFY_RING		16
+
+static unsigned int medium = 60;
+module_param(medium, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(medium, "percentage of scanned pages not freed for medium");
+
+static unsigned int critical = 95;
+module_param(critical, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(critical, "percentage of scanned pages not freed for critical");
+
+static unsigned int critical_priority = 3;
+module_param(critical_priority, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(critical_priority, "reclaim priority at or below which pressure is critical");
+
+static unsigned int ratelimit_ms = 500;
+module_param(ratelimit_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ratelimit_ms, "minimum interval between events of the same level");
+
+static const char *const mem_notify_names[NR_MEM_NOTIFY_LEVELS] = {
+	[MEM_NOTIFY_LOW]	= "low",
+	[MEM_NOTIFY_MEDIUM]	= "medium",
+	[MEM_NOTIFY_CRITICAL]	= "critical",
+};
+
+struct mem_notify_event {
+	unsigned long seq;
+	unsigned long time;
+	enum mem_notify_level level;
+};
+
+struct mem_notify_file {
+	unsigned long seq;		/* first event not read yet */
+	enum mem_notify_level min_level;
+};
+
+/* protects everything below */
+static DEFINE_SPINLOCK(mem_notify_lock);
+static unsigned long mem_notify_scanned;
+static unsigned long mem_notify_reclaimed;
+static struct mem_notify_event mem_notify_ring[MEM_NOTIFY_RING];
+static unsigned long mem_notify_seq;	/* number of events posted */
+
+static DECLARE_WAIT_QUEUE_HEAD(mem_notify_wait);
+
+/* the caller holds mem_notify_lock */
+static int mem_notify_post(enum mem_notify_level level)
+{
+	struct mem_notify_event *last;
+
+	if (mem_notify_seq) {
+		last = &mem_notify_ring[(mem_notify_seq - 1) % MEM_NOTIFY_RING];
+		if (level <= last->level &&
+		    time_before(jiffies, last->time +
+				msecs_to_jiffies(ratelimit_ms)))
+			return 0;
+	}
+
+	last = &mem_notify_ring[mem_notify_seq % MEM_NOTIFY_RING];
+	last->seq = mem_notify_seq++;
+	last->time = jiffies;
+	last->level = level;
+	return 1;
+}
+
+/**
+ * mem_notify_vmscan - account one shrink_zone() pass
+ * @priority: the reclaim priority of the pass
+ * @scanned: pages scanned
+ * @reclaimed: pages freed
+ */
+void mem_notify_vmscan(int priority, unsigned long scanned,
+		       unsigned long reclaimed)
+{
+	enum mem_notify_level level;
+	unsigned long pressure;
+	int posted;
+
+	spin_lock(&mem_notify_lock);
+	mem_notify_scanned += scanned;
+	mem_notify_reclaimed += min(reclaimed, scanned);
+
+	if (priority <= critical_priority && mem_notify_scanned)
+		level = MEM_NOTIFY_CRITICAL;
+	else if (mem_notify_scanned < MEM_NOTIFY_WINDOW) {
+		spin_unlock(&mem_notify_lock);
+		return;
+	} else {
+		pressure = 100 - mem_notify_reclaimed * 100 /
+			mem_notify_scanned;
+		if (pressure >= critical)
+			level = MEM_NOTIFY_CRITICAL;
+		else if (pressure >= medium)
+			level = MEM_NOTIFY_MEDIUM;
+		else
+			level = MEM_NOTIFY_LOW;
+	}
+	mem_notify_scanned = 0;
+	mem_notify_reclaimed = 0;
+	posted = mem_notify_post(level);
+	spin_unlock(&mem_notify_lock);
+
+	if (posted)
+		wake_up_interruptible(&mem_notify_wait);
+}
+
+/*
+ * Find the next event @file should see, skipping those below its level.
+ * The caller holds mem_notify_lock.
+ */
+static struct mem_notify_event *mem_notify_next(struct mem_notify_file *file)
+{
+	struct mem_notify_event *event;
+
+	if (mem_notify_seq - file->seq > MEM_NOTIFY_RING)
+		file->seq = mem_notify_seq - MEM_NOTIFY_RING;
+
+	for (; file->seq != mem_notify_seq; file->seq++) {
+		event = &mem_notify_ring[file->seq % MEM_NOTIFY_RING];
+		if (event->level >= file->min_level)
+			return event;
+	}
+	return NULL;
+}
+
+static int mem_notify_pending(struct mem_notify_file *file)
+{
+	int pending;
+
+	spin_lock(&mem_notify_lock);
+	pending = mem_notify_next(file) != NULL;
+	spin_unlock(&mem_notify_lock);
+	return pending;
+}
+
+static int mem_notify_open(struct inode *inode, struct file *filp)
+{
+	struct mem_notify_file *file;
+
+	file = kzalloc(sizeof(*file), GFP_KERNEL);
+	if (!file)
+		return -ENOMEM;
+
+	/* only events posted from now on */
+	spin_lock(&mem_notify_lock);
+	file->seq = mem_notify_seq;
+	spin_unlock(&mem_notify_lock);
+	file->min_level = MEM_NOTIFY_LOW;
+
+	filp->private_data = file;
+	return nonseekable_open(inode, filp);
+}
+
+static int mem_notify_release(struct inode *inode, struct file *filp)
+{
+	kfree(filp->private_data);
+	return 0;
+}
+
+static ssize_t mem_notify_read(struct file *filp, char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct mem_notify_file *file = filp->private_data;
+	struct mem_notify_event *event;
+	char line[48];
+	int len;
+	int err;
+
+	for (;;) {
+		spin_lock(&mem_notify_lock);
+		event = mem_notify_next(file);
+		if (event) {
+			len = snprintf(line, sizeof(line), "%s %lu %u\n",
+				       mem_notify_names[event->level],
+				       event->seq,
+				       jiffies_to_msecs(jiffies - event->time));
+			if (len <= count)
+				file->seq++;
+			spin_unlock(&mem_notify_lock);
+			break;
+		}
+		spin_unlock(&mem_notify_lock);
+
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		err = wait_event_interruptible(mem_notify_wait,
+					       mem_notify_pending(file));
+		if (err)
+			return err;
+	}
+
+	if (len > count)
+		return -EINVAL;
+	if (copy_to_user(buf, line, len))
+		return -EFAULT;
+	return len;
+}
+
+static ssize_t mem_notify_write(struct file *filp, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct mem_notify_file *file = filp->private_data;
+	char level[16];
+	size_t len = min(count, sizeof(level) - 1);
+	int i;
+
+	if (copy_from_user(level, buf, len))
+		return -EFAULT;
+	level[len] = '\0';
+	strstrip(level);
+
+	for (i = 0; i < NR_MEM_NOTIFY_LEVELS; i++) {
+		if (!strcmp(level, mem_notify_names[i])) {
+			file->min_level = i;
+			return count;
+		}
+	}
+	return -EINVAL;
+}
+
+static unsigned int mem_notify_poll(struct file *filp, poll_table *wait)
+{
+	struct mem_notify_file *file = filp->private_data;
+
+	poll_wait(filp, &mem_notify_wait, wait);
+	if (mem_notify_pending(file))
+		return POLLIN | POLLRDNORM;
+	return 0;
+}
+
+static const struct file_operations mem_notify_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mem_notify_open,
+	.release	= mem_notify_release,
+	.read		= mem_notify_read,
+	.write		= mem_notify_write,
+	.poll		= mem_notify_poll,
+};
+
+static struct miscdevice mem_notify_dev = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "mem_notify",
+	.fops	= &mem_notify_fops,
+};
+
+static int __init mem_notify_init(void)
+{
+	return misc_register(&mem_notify_dev);
+}
+module_init(mem_notify_init)
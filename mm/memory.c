@@ -46,6 +46,7 @@
 #include <linux/highmem.h>
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
+#include <linux/ksm.h>
 #include <linux/module.h>
 #include <linux/delayacct.h>
 #include <linux/init.h>
@@ -603,9 +604,55 @@ out_set_pte:
 	set_pte_at(dst_mm, addr, dst_pte, pte);
 }
 
+/*
+ * Page cache pages mapped by a file mapping need not be copied at fork: a
+ * fault in the child maps the same page again.  Only anonymous pages (and
+ * swap entries) have to be copied from a private file mapping that has
+ * some, and a page table holding none of them is not even allocated.
+ * This saves taking a reference and a mapcount on every library and dex
+ * page of a large parent, pages which all of its children share.
+ */
+int sysctl_lazy_fork = 1;
+
+static inline int lazy_fork_vma(struct vm_area_struct *vma)
+{
+	return sysctl_lazy_fork && vma->vm_file &&
+		!(vma->vm_flags & (VM_HUGETLB|VM_NONLINEAR|VM_PFNMAP|
+				   VM_INSERTPAGE|VM_MIXEDMAP));
+}
+
+/* Can a fault in the child fill in this pte again? */
+static inline int lazy_fork_pte(struct vm_area_struct *vma,
+				unsigned long addr, pte_t pte)
+{
+	struct page *page;
+
+	if (!pte_present(pte))
+		return 0;
+	page = vm_normal_page(vma, addr, pte);
+	return page && !PageAnon(page);
+}
+
+static int lazy_fork_pte_range(struct mm_struct *src_mm, pmd_t *src_pmd,
+		struct vm_area_struct *vma, unsigned long addr,
+		unsigned long end)
+{
+	spinlock_t *ptl;
+	pte_t *pte;
+	int lazy = 1;
+
+	pte = pte_offset_map_lock(src_mm, src_pmd, addr, &ptl);
+	do {
+		if (!pte_none(*pte) && !lazy_fork_pte(vma, addr, *pte))
+			lazy = 0;
+	} while (pte++, addr += PAGE_SIZE, lazy && addr != end);
+	pte_unmap_unlock(pte - 1, ptl);
+	return lazy;
+}
+
 static int copy_pte_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pmd_t *dst_pmd, pmd_t *src_pmd, struct vm_area_struct *vma,
-		unsigned long addr, unsigned long end)
+		unsigned long addr, unsigned long end, int lazy)
 {
 	pte_t *src_pte, *dst_pte;
 	spinlock_t *src_ptl, *dst_ptl;
@@ -633,7 +680,8 @@ again:
 			    spin_needbreak(src_ptl) || spin_needbreak(dst_ptl))
 				break;
 		}
-		if (pte_none(*src_pte)) {
+		if (pte_none(*src_pte) ||
+		    (lazy && lazy_fork_pte(vma, addr, *src_pte))) {
 			progress++;
 			continue;
 		}
@@ -654,7 +702,7 @@ again:
 
 static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pud_t *dst_pud, pud_t *src_pud, struct vm_area_struct *vma,
-		unsigned long addr, unsigned long end)
+		unsigned long addr, unsigned long end, int lazy)
 {
 	pmd_t *src_pmd, *dst_pmd;
 	unsigned long next;
@@ -667,8 +715,11 @@ static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src
 		next = pmd_addr_end(addr, end);
 		if (pmd_none_or_clear_bad(src_pmd))
 			continue;
+		if (lazy && lazy_fork_pte_range(src_mm, src_pmd, vma,
+						addr, next))
+			continue;
 		if (copy_pte_range(dst_mm, src_mm, dst_pmd, src_pmd,
-						vma, addr, next))
+						vma, addr, next, lazy))
 			return -ENOMEM;
 	} while (dst_pmd++, src_pmd++, addr = next, addr != end);
 	return 0;
@@ -676,7 +727,7 @@ static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src
 
 static inline int copy_pud_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pgd_t *dst_pgd, pgd_t *src_pgd, struct vm_area_struct *vma,
-		unsigned long addr, unsigned long end)
+		unsigned long addr, unsigned long end, int lazy)
 {
 	pud_t *src_pud, *dst_pud;
 	unsigned long next;
@@ -690,7 +741,7 @@ static inline int copy_pud_range(struct mm_struct *dst_mm, struct mm_struct *src
 		if (pud_none_or_clear_bad(src_pud))
 			continue;
 		if (copy_pmd_range(dst_mm, src_mm, dst_pud, src_pud,
-						vma, addr, next))
+						vma, addr, next, lazy))
 			return -ENOMEM;
 	} while (dst_pud++, src_pud++, addr = next, addr != end);
 	return 0;
@@ -703,6 +754,7 @@ int copy_page_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 	unsigned long next;
 	unsigned long addr = vma->vm_start;
 	unsigned long end = vma->vm_end;
+	int lazy = lazy_fork_vma(vma);
 	int ret;
 
 	/*
@@ -746,7 +798,7 @@ int copy_page_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		if (pgd_none_or_clear_bad(src_pgd))
 			continue;
 		if (unlikely(copy_pud_range(dst_mm, src_mm, dst_pgd, src_pgd,
-					    vma, addr, next))) {
+					    vma, addr, next, lazy))) {
 			ret = -ENOMEM;
 			break;
 		}
@@ -1916,7 +1968,7 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	 * Take out anonymous pages first, anonymous shared vmas are
 	 * not dirty accountable.
 	 */
-	if (PageAnon(old_page)) {
+	if (PageAnon(old_page) && !PageKsm(old_page)) {
 		if (!trylock_page(old_page)) {
 			page_cache_get(old_page);
 			pte_unmap_unlock(page_table, ptl);
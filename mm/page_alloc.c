@@ -46,6 +46,7 @@
 #include <linux/page-isolation.h>
 #include <linux/page_cgroup.h>
 #include <linux/debugobjects.h>
+#include <linux/compaction.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -77,6 +78,7 @@ int pageblock_order __read_mostly;
 #endif
 
 static void __free_pages_ok(struct page *page, unsigned int order);
+static void free_high_order_page(struct page *page, int order);
 
 /*
  * results with 256, 32 in the lowmem_reserve sysctl:
@@ -565,7 +567,10 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 
 	local_irq_save(flags);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order);
+	if (order <= PCP_HIGH_ORDERS)
+		free_high_order_page(page, order);
+	else
+		free_one_page(page_zone(page), page, order);
 	local_irq_restore(flags);
 }
 
@@ -886,6 +891,84 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 	return i;
 }
 
+/* Number of blocks of @order the pcp may hold; 0 in the boot pagesets */
+static inline int pcp_high_order_max(struct per_cpu_pages *pcp, int order)
+{
+	return pcp->batch >> order;
+}
+
+/*
+ * Take a block of @order from the per-cpu list, refilling the list from
+ * the buddy allocator when it holds none of @migratetype.
+ * Called with interrupts disabled.
+ */
+static struct page *rmqueue_high_order(struct zone *zone,
+		struct per_cpu_pages *pcp, int order, int migratetype)
+{
+	struct list_head *list = &pcp->hlist[order - 1];
+	struct page *page;
+
+	list_for_each_entry(page, list, lru)
+		if (page_private(page) == migratetype)
+			goto found;
+
+	pcp->hcount[order - 1] += rmqueue_bulk(zone, order,
+			max(pcp_high_order_max(pcp, order) / 2, 1),
+			list, migratetype);
+	if (list_empty(list))
+		return NULL;
+	/* of another migratetype if the buddy lists had none left */
+	page = list_entry(list->next, struct page, lru);
+found:
+	list_del(&page->lru);
+	pcp->hcount[order - 1]--;
+	return page;
+}
+
+/*
+ * Free a block of order 1 to PCP_HIGH_ORDERS to the per-cpu list of its
+ * order, and hand the oldest half back to the buddy allocator when the
+ * list is full.  Called with interrupts disabled.
+ */
+static void free_high_order_page(struct page *page, int order)
+{
+	struct zone *zone = page_zone(page);
+	struct per_cpu_pages *pcp = &zone_pcp(zone, smp_processor_id())->pcp;
+	int limit = pcp_high_order_max(pcp, order);
+	int batch;
+
+	if (!limit) {
+		free_one_page(zone, page, order);
+		return;
+	}
+	if (unlikely(PageCompound(page)))
+		if (unlikely(destroy_compound_page(page, order)))
+			return;
+
+	list_add(&page->lru, &pcp->hlist[order - 1]);
+	set_page_private(page, get_pageblock_migratetype(page));
+	if (++pcp->hcount[order - 1] > limit) {
+		batch = max(limit / 2, 1);
+		free_pages_bulk(zone, batch, &pcp->hlist[order - 1], order);
+		pcp->hcount[order - 1] -= batch;
+	}
+}
+
+/* Called with interrupts disabled */
+static void drain_high_order_pages(struct zone *zone,
+				   struct per_cpu_pages *pcp)
+{
+	int order;
+
+	for (order = 1; order <= PCP_HIGH_ORDERS; order++) {
+		if (!pcp->hcount[order - 1])
+			continue;
+		free_pages_bulk(zone, pcp->hcount[order - 1],
+				&pcp->hlist[order - 1], order);
+		pcp->hcount[order - 1] = 0;
+	}
+}
+
 #ifdef CONFIG_NUMA
 /*
  * Called from the vmstat counter updater to drain pagesets of this
@@ -936,6 +1019,7 @@ static void drain_pages(unsigned int cpu)
 		local_irq_save(flags);
 		free_pages_bulk(zone, pcp->count, &pcp->list, 0);
 		pcp->count = 0;
+		drain_high_order_pages(zone, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1058,6 +1142,40 @@ void split_page(struct page *page, unsigned int order)
 		set_page_refcounted(page + i);
 }
 
+#ifdef CONFIG_COMPACTION
+/*
+ * Take the free block @page off the buddy lists and split it into order-0
+ * pages for page compaction to migrate into.  Refuses when that would
+ * leave the zone below its low watermark.  Returns the number of pages.
+ * Called with zone->lock held.
+ */
+int split_free_page(struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned int order = page_order(page);
+	struct page *endpage;
+
+	if (!zone_watermark_ok(zone, 0, zone->pages_low + (1 << order), 0, 0))
+		return 0;
+
+	list_del(&page->lru);
+	zone->free_area[order].nr_free--;
+	rmv_page_order(page);
+	__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+
+	set_page_refcounted(page);
+	split_page(page, order);
+
+	/* whole pageblocks taken become movable, like the pages put there */
+	if (order >= pageblock_order - 1) {
+		endpage = page + (1 << order) - 1;
+		for (; page < endpage; page += pageblock_nr_pages)
+			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
+	}
+	return 1 << order;
+}
+#endif
+
 /*
  * Really, prep_compound_page() should be called from __rmqueue_bulk().  But
  * we cheat by calling it from here, in the order > 0 path.  Saves a branch
@@ -1106,6 +1224,13 @@ again:
 
 		list_del(&page->lru);
 		pcp->count--;
+	} else if (order <= PCP_HIGH_ORDERS &&
+		   pcp_high_order_max(&zone_pcp(zone, cpu)->pcp, order)) {
+		local_irq_save(flags);
+		page = rmqueue_high_order(zone, &zone_pcp(zone, cpu)->pcp,
+					  order, migratetype);
+		if (!page)
+			goto failed;
 	} else {
 		spin_lock_irqsave(&zone->lock, flags);
 		page = __rmqueue(zone, order, migratetype);
@@ -1514,6 +1639,8 @@ restart:
 
 	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx)
 		wakeup_kswapd(zone, order);
+	if (order)
+		wakeup_kcompactd(order);
 
 	/*
 	 * OK, we're below the kswapd watermark and have kicked background
@@ -2735,6 +2862,7 @@ static int zone_batchsize(struct zone *zone)
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
+	int i;
 
 	memset(p, 0, sizeof(*p));
 
@@ -2743,6 +2871,8 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->high = 6 * batch;
 	pcp->batch = max(1UL, 1 * batch);
 	INIT_LIST_HEAD(&pcp->list);
+	for (i = 0; i < PCP_HIGH_ORDERS; i++)
+		INIT_LIST_HEAD(&pcp->hlist[i]);
 }
 
 /*
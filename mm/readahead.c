@@ -16,6 +16,9 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
+#include <linux/boot_preload.h>
 
 void default_unplug_io_fn(struct backing_dev_info *bdi, struct page *page)
 {
@@ -100,7 +103,10 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		list_del(&page->lru);
 		if (!add_to_page_cache_lru(page, mapping,
 					page->index, GFP_KERNEL)) {
-			mapping->a_ops->readpage(filp, page);
+			if (PageUptodate(page))
+				unlock_page(page);
+			else
+				mapping->a_ops->readpage(filp, page);
 		}
 		page_cache_release(page);
 	}
@@ -168,8 +174,11 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
-	if (ret)
+	if (ret) {
+		boot_preload_record(filp, offset,
+				    min(nr_to_read, end_index - offset + 1));
 		read_pages(mapping, filp, &page_pool, ret);
+	}
 	BUG_ON(!list_empty(&page_pool));
 out:
 	return ret;
@@ -481,3 +490,179 @@ page_cache_async_readahead(struct address_space *mapping,
 	ondemand_readahead(mapping, ra, filp, true, offset, req_size);
 }
 EXPORT_SYMBOL_GPL(page_cache_async_readahead);
+
+#ifdef CONFIG_READAHEAD_HISTORY
+/*
+ * Readahead history of mmapped files.
+ *
+ * Code and resources in APKs, dex files and libraries are faulted in at
+ * random, so the read-around of filemap_fault() soon gives up on them and
+ * every launch reads them a page at a time.  But the same launch touches
+ * the same parts of those files every time.  So the chunks of a file which
+ * took major faults are remembered per inode, and on the first major fault
+ * through the next struct file of that inode, all of them are read in at
+ * once, each run of adjacent chunks with one batched readahead.
+ *
+ * The history stays in memory only, for the last RA_HISTORY_FILES files
+ * faulted in, and is thrown away when the size or mtime of a file change.
+ */
+#define RA_HISTORY_BITS		1024	/* chunks remembered per file */
+#define RA_HISTORY_MIN_SHIFT	4	/* chunks are at least 16 pages */
+#define RA_HISTORY_FILES	256
+#define RA_HISTORY_HASH_SHIFT	6
+
+struct ra_history {
+	struct hlist_node hash;
+	struct list_head lru;		/* most recently faulted first */
+	dev_t dev;
+	unsigned long ino;
+	loff_t size;
+	struct timespec mtime;
+	unsigned int chunk_shift;	/* log2 of pages per chunk */
+	DECLARE_BITMAP(hot, RA_HISTORY_BITS);
+};
+
+static DEFINE_SPINLOCK(ra_history_lock);
+static struct hlist_head ra_history_hash[1 << RA_HISTORY_HASH_SHIFT];
+static LIST_HEAD(ra_history_lru);
+static unsigned int ra_history_nr;
+
+static struct hlist_head *ra_history_bucket(dev_t dev, unsigned long ino)
+{
+	return &ra_history_hash[hash_long(ino ^ dev, RA_HISTORY_HASH_SHIFT)];
+}
+
+/* (re)start the history of @inode; the caller holds ra_history_lock */
+static void ra_history_reset(struct ra_history *h, struct inode *inode)
+{
+	unsigned long pages;
+
+	h->size = i_size_read(inode);
+	h->mtime = inode->i_mtime;
+	pages = (h->size + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	h->chunk_shift = RA_HISTORY_MIN_SHIFT;
+	while ((pages >> h->chunk_shift) >= RA_HISTORY_BITS)
+		h->chunk_shift++;
+	bitmap_zero(h->hot, RA_HISTORY_BITS);
+}
+
+/* the caller holds ra_history_lock */
+static struct ra_history *ra_history_lookup(struct inode *inode)
+{
+	struct hlist_head *bucket;
+	struct hlist_node *node;
+	struct ra_history *h;
+
+	bucket = ra_history_bucket(inode->i_sb->s_dev, inode->i_ino);
+	hlist_for_each_entry(h, node, bucket, hash) {
+		if (h->ino == inode->i_ino && h->dev == inode->i_sb->s_dev)
+			return h;
+	}
+	return NULL;
+}
+
+/*
+ * Find the history of @inode, or start one in @new, or else in the least
+ * recently used one.  The caller holds ra_history_lock.
+ */
+static struct ra_history *ra_history_get(struct inode *inode,
+					 struct ra_history **new)
+{
+	struct ra_history *h;
+
+	h = ra_history_lookup(inode);
+	if (h) {
+		if (h->size != i_size_read(inode) ||
+		    !timespec_equal(&h->mtime, &inode->i_mtime))
+			ra_history_reset(h, inode);
+		list_move(&h->lru, &ra_history_lru);
+	} else {
+		if (ra_history_nr < RA_HISTORY_FILES && *new) {
+			h = *new;
+			*new = NULL;
+			ra_history_nr++;
+		} else if (!list_empty(&ra_history_lru)) {
+			h = list_entry(ra_history_lru.prev,
+				       struct ra_history, lru);
+			hlist_del(&h->hash);
+			list_del(&h->lru);
+		} else
+			return NULL;
+
+		h->dev = inode->i_sb->s_dev;
+		h->ino = inode->i_ino;
+		ra_history_reset(h, inode);
+		hlist_add_head(&h->hash,
+			       ra_history_bucket(h->dev, h->ino));
+		list_add(&h->lru, &ra_history_lru);
+	}
+	return h;
+}
+
+static void ra_history_replay(struct address_space *mapping,
+			      struct file *filp, unsigned long *hot,
+			      unsigned int chunk_shift)
+{
+	unsigned long start, end;
+	unsigned long nr;
+
+	start = find_first_bit(hot, RA_HISTORY_BITS);
+	while (start < RA_HISTORY_BITS) {
+		end = find_next_zero_bit(hot, RA_HISTORY_BITS, start);
+		nr = (end - start) << chunk_shift;
+		if (max_sane_readahead(nr) < nr)
+			break;
+		if (bdi_read_congested(mapping->backing_dev_info))
+			break;
+		force_page_cache_readahead(mapping, filp,
+					   start << chunk_shift, nr);
+		start = find_next_bit(hot, RA_HISTORY_BITS, end);
+	}
+}
+
+/**
+ * page_cache_fault_history - record a major fault, replay older ones
+ * @mapping: address_space which holds the pagecache and I/O vectors
+ * @ra: file_ra_state of @filp
+ * @filp: the mapped file
+ * @offset: page index of the fault
+ *
+ * Called by filemap_fault() when the page was not in the page cache.
+ */
+void page_cache_fault_history(struct address_space *mapping,
+			      struct file_ra_state *ra, struct file *filp,
+			      pgoff_t offset)
+{
+	struct inode *inode = mapping->host;
+	struct ra_history *h, *new = NULL;
+	DECLARE_BITMAP(hot, RA_HISTORY_BITS);
+	unsigned int chunk_shift = 0;
+	int replay = 0;
+
+	if (!S_ISREG(inode->i_mode) || !ra->ra_pages)
+		return;
+
+	if (ra_history_nr < RA_HISTORY_FILES)
+		new = kmalloc(sizeof(*new), GFP_KERNEL);
+
+	spin_lock(&ra_history_lock);
+	h = ra_history_get(inode, &new);
+	if (h) {
+		if (!ra->history_replayed) {
+			ra->history_replayed = 1;
+			replay = !bitmap_empty(h->hot, RA_HISTORY_BITS);
+			if (replay) {
+				bitmap_copy(hot, h->hot, RA_HISTORY_BITS);
+				chunk_shift = h->chunk_shift;
+			}
+		}
+		if ((offset >> h->chunk_shift) < RA_HISTORY_BITS)
+			__set_bit(offset >> h->chunk_shift, h->hot);
+	}
+	spin_unlock(&ra_history_lock);
+	kfree(new);
+
+	if (replay)
+		ra_history_replay(mapping, filp, hot, chunk_shift);
+}
+#endif /* CONFIG_READAHEAD_HISTORY */
@@ -112,6 +112,10 @@
 #include	<linux/rtmutex.h>
 #include	<linux/reciprocal_div.h>
 #include	<linux/debugobjects.h>
+#include	<linux/random.h>
+#include	<linux/sort.h>
+#include	<linux/vmalloc.h>
+#include	<linux/math64.h>
 
 #include	<asm/cacheflush.h>
 #include	<asm/tlbflush.h>
@@ -3116,6 +3120,74 @@ static bool slab_should_failslab(struct kmem_cache *cachep, gfp_t flags)
 	return should_failslab(obj_size(cachep), flags);
 }
 
+#ifdef CONFIG_SLAB_SAMPLE
+/*
+ * Allocation sampling: about one in slab_sample_period allocations records
+ * its call site, cache and object size in a per-cpu ring, read back as
+ * /proc/slab_sample.  The common path only decrements a per-cpu counter.
+ */
+#define SLAB_SAMPLE_RING	1024
+
+struct slab_sample {
+	void *caller;
+	struct kmem_cache *cachep;
+	unsigned int size;
+	unsigned long time;		/* jiffies */
+};
+
+struct slab_sample_cpu {
+	unsigned int countdown;		/* allocations to the next sample */
+	unsigned int head;		/* samples taken, the ring wraps */
+	struct slab_sample ring[SLAB_SAMPLE_RING];
+};
+
+static unsigned int slab_sample_period = 512;
+static DEFINE_PER_CPU(struct slab_sample_cpu *, slab_sample_cpu);
+
+/* The distance to the next sample is random, not to alias with loops */
+static unsigned int slab_sample_next(void)
+{
+	unsigned int period = slab_sample_period;
+
+	if (!period)
+		return UINT_MAX;
+	return period / 2 + random32() % period + 1;
+}
+
+static noinline void __slab_sample(struct slab_sample_cpu *sc,
+				   struct kmem_cache *cachep, void *objp,
+				   void *caller)
+{
+	struct slab_sample *sample;
+
+	sc->countdown = slab_sample_next();
+	if (!objp || !slab_sample_period)
+		return;
+
+	sample = &sc->ring[sc->head++ % SLAB_SAMPLE_RING];
+	sample->caller = caller;
+	sample->cachep = cachep;
+	sample->size = obj_size(cachep);
+	sample->time = jiffies;
+}
+
+/* Called with interrupts disabled */
+static __always_inline void slab_sample(struct kmem_cache *cachep,
+					void *objp, void *caller)
+{
+	struct slab_sample_cpu *sc = __get_cpu_var(slab_sample_cpu);
+
+	if (likely(!sc || --sc->countdown))
+		return;
+	__slab_sample(sc, cachep, objp, caller);
+}
+#else
+static inline void slab_sample(struct kmem_cache *cachep, void *objp,
+			       void *caller)
+{
+}
+#endif
+
 static inline void *____cache_alloc(struct kmem_cache *cachep, gfp_t flags)
 {
 	void *objp;
@@ -3347,6 +3419,7 @@ __cache_alloc_node(struct kmem_cache *cachep, gfp_t flags, int nodeid,
 	/* ___cache_alloc_node can fall back to other nodes */
 	ptr = ____cache_alloc_node(cachep, flags, nodeid);
   out:
+	slab_sample(cachep, ptr, caller);
 	local_irq_restore(save_flags);
 	ptr = cache_alloc_debugcheck_after(cachep, flags, ptr, caller);
 
@@ -3400,6 +3473,7 @@ __cache_alloc(struct kmem_cache *cachep, gfp_t flags, void *caller)
 	cache_alloc_debugcheck_before(cachep, flags);
 	local_irq_save(save_flags);
 	objp = __do_cache_alloc(cachep, flags);
+	slab_sample(cachep, objp, caller);
 	local_irq_restore(save_flags);
 	objp = cache_alloc_debugcheck_after(cachep, flags, objp, caller);
 	prefetchw(objp);
@@ -3554,6 +3628,68 @@ void *kmem_cache_alloc(struct kmem_cache *cachep, gfp_t flags)
 }
 EXPORT_SYMBOL(kmem_cache_alloc);
 
+/**
+ * kmem_cache_alloc_bulk - Allocate several objects at once
+ * @cachep: The cache to allocate from.
+ * @flags: See kmalloc().
+ * @nr: The number of objects to allocate.
+ * @p: Array receiving the objects.
+ *
+ * The objects are taken from the per-cpu array in one go, with interrupts
+ * disabled only once for the whole batch; the array is refilled through
+ * the normal path whenever it runs dry.  Returns @nr on success.  On
+ * failure, whatever was allocated is freed again and 0 is returned.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *cachep, gfp_t flags, size_t nr,
+			  void **p)
+{
+	void *caller = __builtin_return_address(0);
+	unsigned long save_flags;
+	size_t i = 0, j;
+
+	if (slab_should_failslab(cachep, flags))
+		return 0;
+
+	cache_alloc_debugcheck_before(cachep, flags);
+	local_irq_save(save_flags);
+	while (i < nr) {
+		struct array_cache *ac = cpu_cache_get(cachep);
+		size_t n = min_t(size_t, nr - i, ac->avail);
+
+		if (!n || (NUMA_BUILD &&
+			   (current->flags & (PF_SPREAD_SLAB | PF_MEMPOLICY)))) {
+			/* refill, or honour the memory policy, one at a time */
+			p[i] = __do_cache_alloc(cachep, flags);
+			if (unlikely(!p[i]))
+				break;
+			i++;
+			continue;
+		}
+		ac->avail -= n;
+		ac->touched = 1;
+		memcpy(&p[i], &ac->entry[ac->avail], sizeof(void *) * n);
+		for (j = 0; j < n; j++)
+			STATS_INC_ALLOCHIT(cachep);
+		i += n;
+	}
+	for (j = 0; j < i; j++)
+		slab_sample(cachep, p[j], caller);
+	local_irq_restore(save_flags);
+
+	for (j = 0; j < i; j++) {
+		p[j] = cache_alloc_debugcheck_after(cachep, flags, p[j], caller);
+		if (unlikely(flags & __GFP_ZERO))
+			memset(p[j], 0, obj_size(cachep));
+	}
+
+	if (unlikely(i < nr)) {
+		kmem_cache_free_bulk(cachep, i, p);
+		return 0;
+	}
+	return nr;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 /**
  * kmem_ptr_validate - check if an untrusted pointer might be a slab entry.
  * @cachep: the cache we're checking against
@@ -3792,6 +3928,48 @@ void kmem_cache_free(struct kmem_cache *cachep, void *objp)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/**
+ * kmem_cache_free_bulk - Deallocate several objects at once
+ * @cachep: The cache the allocations were from.
+ * @nr: The number of objects.
+ * @p: The previously allocated objects.
+ *
+ * The objects are stored into the per-cpu array in one go, which is
+ * flushed a batch at a time whenever it fills up.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *cachep, size_t nr, void **p)
+{
+	unsigned long flags;
+	size_t i, n;
+
+	local_irq_save(flags);
+	for (i = 0; i < nr; i++) {
+		debug_check_no_locks_freed(p[i], obj_size(cachep));
+		if (!(cachep->flags & SLAB_DEBUG_OBJECTS))
+			debug_check_no_obj_freed(p[i], obj_size(cachep));
+	}
+
+	if (numa_platform || DEBUG) {
+		/* objects may have to go back to other nodes */
+		for (i = 0; i < nr; i++)
+			__cache_free(cachep, p[i]);
+	} else {
+		struct array_cache *ac = cpu_cache_get(cachep);
+
+		for (i = 0; i < nr; i += n) {
+			if (ac->avail == ac->limit) {
+				STATS_INC_FREEMISS(cachep);
+				cache_flusharray(cachep, ac);
+			}
+			n = min_t(size_t, nr - i, ac->limit - ac->avail);
+			memcpy(&ac->entry[ac->avail], &p[i], sizeof(void *) * n);
+			ac->avail += n;
+		}
+	}
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
 /**
  * kfree - free previously allocated memory
  * @objp: pointer returned by kmalloc.
@@ -4516,11 +4694,196 @@ static const struct file_operations proc_slabstats_operations = {
 };
 #endif
 
+#ifdef CONFIG_SLAB_SAMPLE
+
+/* the samples of one call site and cache */
+struct slab_sample_site {
+	void *caller;
+	struct kmem_cache *cachep;
+	unsigned long count;
+	unsigned long bytes;
+};
+
+static int slab_sample_cmp_site(const void *a, const void *b)
+{
+	const struct slab_sample_site *sa = a, *sb = b;
+
+	if (sa->caller != sb->caller)
+		return sa->caller < sb->caller ? -1 : 1;
+	if (sa->cachep != sb->cachep)
+		return sa->cachep < sb->cachep ? -1 : 1;
+	return 0;
+}
+
+static int slab_sample_cmp_bytes(const void *a, const void *b)
+{
+	const struct slab_sample_site *sa = a, *sb = b;
+
+	if (sa->bytes != sb->bytes)
+		return sa->bytes > sb->bytes ? -1 : 1;
+	return 0;
+}
+
+/* the name of @cachep, if it still exists; needs cache_chain_mutex */
+static const char *slab_sample_cache_name(struct kmem_cache *cachep)
+{
+	struct kmem_cache *c;
+
+	list_for_each_entry(c, &cache_chain, next)
+		if (c == cachep)
+			return c->name;
+	return "(destroyed)";
+}
+
+/* per second, of all allocations, for @n samples over @window jiffies */
+static unsigned long slab_sample_rate(unsigned long n, unsigned int period,
+				      unsigned long window)
+{
+	return div_u64((u64)n * period * HZ, window);
+}
+
+/*
+ * Collect the samples of all cpus, sum them up per call site and cache,
+ * and print the sites by bytes allocated per second.  The rings are read
+ * while they are being written, a sample overwritten meanwhile may be
+ * counted for the wrong site.
+ */
+static int slab_sample_show(struct seq_file *m, void *v)
+{
+	struct slab_sample_site *sites;
+	unsigned int period = slab_sample_period;
+	unsigned long oldest = jiffies, window;
+	unsigned long nr = 0, nr_samples;
+	unsigned long i, j;
+	int cpu;
+
+	sites = vmalloc(num_possible_cpus() * SLAB_SAMPLE_RING *
+			sizeof(*sites));
+	if (!sites)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct slab_sample_cpu *sc = per_cpu(slab_sample_cpu, cpu);
+		unsigned int n;
+
+		if (!sc)
+			continue;
+		n = min_t(unsigned int, sc->head, SLAB_SAMPLE_RING);
+		for (i = 0; i < n; i++) {
+			struct slab_sample sample = sc->ring[i];
+
+			if (!sample.caller)
+				continue;
+			sites[nr].caller = sample.caller;
+			sites[nr].cachep = sample.cachep;
+			sites[nr].count = 1;
+			sites[nr].bytes = sample.size;
+			if (time_before(sample.time, oldest))
+				oldest = sample.time;
+			nr++;
+		}
+	}
+	nr_samples = nr;
+	window = max(jiffies - oldest, 1UL);
+
+	sort(sites, nr, sizeof(*sites), slab_sample_cmp_site, NULL);
+	for (i = 0, j = 0; i < nr; i++) {
+		if (j && !slab_sample_cmp_site(&sites[j - 1], &sites[i])) {
+			sites[j - 1].count++;
+			sites[j - 1].bytes += sites[i].bytes;
+		} else
+			sites[j++] = sites[i];
+	}
+	nr = j;
+	sort(sites, nr, sizeof(*sites), slab_sample_cmp_bytes, NULL);
+
+	seq_printf(m, "# 1 in %u allocations, %lu samples over %u ms\n",
+		   period, nr_samples, jiffies_to_msecs(window));
+	seq_puts(m, "#  bytes/s allocs/s cache                caller\n");
+
+	mutex_lock(&cache_chain_mutex);
+	for (i = 0; i < nr; i++)
+		seq_printf(m, "%10lu %8lu %-20s %pS\n",
+			   slab_sample_rate(sites[i].bytes, period, window),
+			   slab_sample_rate(sites[i].count, period, window),
+			   slab_sample_cache_name(sites[i].cachep),
+			   sites[i].caller);
+	mutex_unlock(&cache_chain_mutex);
+
+	vfree(sites);
+	return 0;
+}
+
+static int slab_sample_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, slab_sample_show, NULL);
+}
+
+/*
+ * Writing a number sets the sampling period, 0 stops sampling.  Either
+ * way the samples taken so far are dropped.
+ */
+static ssize_t slab_sample_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	char kbuf[16];
+	unsigned long period;
+	int cpu;
+
+	if (count >= sizeof(kbuf))
+		return -EINVAL;
+	if (copy_from_user(kbuf, buf, count))
+		return -EFAULT;
+	kbuf[count] = '\0';
+	if (strict_strtoul(strstrip(kbuf), 10, &period) || period > UINT_MAX)
+		return -EINVAL;
+
+	slab_sample_period = period;
+	for_each_possible_cpu(cpu) {
+		struct slab_sample_cpu *sc = per_cpu(slab_sample_cpu, cpu);
+
+		if (!sc)
+			continue;
+		sc->head = 0;
+		sc->countdown = slab_sample_next();
+	}
+	return count;
+}
+
+static const struct file_operations proc_slab_sample_operations = {
+	.open		= slab_sample_open,
+	.read		= seq_read,
+	.write		= slab_sample_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init slab_sample_init(void)
+{
+	struct slab_sample_cpu *sc;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		sc = vmalloc(sizeof(*sc));
+		if (!sc)
+			return;
+		memset(sc, 0, sizeof(*sc));
+		sc->countdown = slab_sample_next();
+		per_cpu(slab_sample_cpu, cpu) = sc;
+	}
+	proc_create("slab_sample", S_IWUSR | S_IRUSR, NULL,
+		    &proc_slab_sample_operations);
+}
+#endif
+
 static int __init slab_proc_init(void)
 {
 	proc_create("slabinfo",S_IWUSR|S_IRUGO,NULL,&proc_slabinfo_operations);
 #ifdef CONFIG_DEBUG_SLAB_LEAK
 	proc_create("slab_allocators", 0, NULL, &proc_slabstats_operations);
+#endif
+#ifdef CONFIG_SLAB_SAMPLE
+	slab_sample_init();
 #endif
 	return 0;
 }
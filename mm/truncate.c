@@ -16,6 +16,8 @@
 #include <linux/highmem.h>
 #include <linux/pagevec.h>
 #include <linux/task_io_accounting_ops.h>
+#include <linux/ccache.h>
+#include <linux/workingset.h>
 #include <linux/buffer_head.h>	/* grr. try_to_release_page,
 				   do_invalidatepage */
 #include "internal.h"
@@ -168,6 +170,11 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	pgoff_t next;
 	int i;
 
+	/* includes the partial page, its tail must read back as zeroes */
+	ccache_invalidate_range(mapping, lstart >> PAGE_CACHE_SHIFT,
+				lend >> PAGE_CACHE_SHIFT);
+	workingset_invalidate_range(mapping, start, lend >> PAGE_CACHE_SHIFT);
+
 	if (mapping->nrpages == 0)
 		return;
 
@@ -251,6 +258,9 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		}
 		pagevec_release(&pvec);
 	}
+
+	/* reclaim may have stored pages we had not got to yet */
+	ccache_invalidate_range(mapping, start, end);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
 
@@ -15,6 +15,9 @@
 #include <linux/cpu.h>
 #include <linux/vmstat.h>
 #include <linux/sched.h>
+#include <linux/math64.h>
+
+#include "internal.h"
 
 #ifdef CONFIG_VM_EVENT_COUNTERS
 DEFINE_PER_CPU(struct vm_event_state, vm_event_states) = {{0}};
@@ -383,6 +386,35 @@ void zone_statistics(struct zone *preferred_zone, struct zone *z)
 }
 #endif
 
+/*
+ * The fragmentation index of a zone for an order tells why an allocation
+ * of that order would fail: towards 0 for lack of free memory, which only
+ * reclaim can help, towards 1000 for the free memory being in blocks too
+ * small, which compaction can help.  It is -1000 while the allocation
+ * would succeed.
+ */
+int fragmentation_index(struct zone *zone, unsigned int order)
+{
+	unsigned long requested = 1UL << order;
+	unsigned long free_pages = 0;
+	unsigned long free_blocks = 0;
+	unsigned int i;
+
+	for (i = 0; i < MAX_ORDER; i++) {
+		unsigned long blocks = zone->free_area[i].nr_free;
+
+		if (i >= order && blocks)
+			return -1000;
+		free_blocks += blocks;
+		free_pages += blocks << i;
+	}
+	if (!free_blocks)
+		return 0;
+
+	return 1000 - div_u64(1000 + div_u64(free_pages * 1000ULL, requested),
+			      free_blocks);
+}
+
 #ifdef CONFIG_PROC_FS
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
@@ -458,6 +490,30 @@ static int frag_show(struct seq_file *m, void *arg)
 	return 0;
 }
 
+static void extfrag_show_print(struct seq_file *m, pg_data_t *pgdat,
+						struct zone *zone)
+{
+	int order, index;
+
+	seq_printf(m, "Node %d, zone %8s ", pgdat->node_id, zone->name);
+	for (order = 0; order < MAX_ORDER; ++order) {
+		index = fragmentation_index(zone, order);
+		seq_printf(m, "%s%d.%03d ", index < 0 ? "-" : "",
+			   abs(index) / 1000, abs(index) % 1000);
+	}
+	seq_putc(m, '\n');
+}
+
+/*
+ * This shows the fragmentation index of each zone for each order.
+ */
+static int extfrag_show(struct seq_file *m, void *arg)
+{
+	pg_data_t *pgdat = (pg_data_t *)arg;
+	walk_zones_in_node(m, pgdat, extfrag_show_print);
+	return 0;
+}
+
 static void pagetypeinfo_showfree_print(struct seq_file *m,
 					pg_data_t *pgdat, struct zone *zone)
 {
@@ -600,6 +656,25 @@ static const struct file_operations fragmentation_file_operations = {
 	.release	= seq_release,
 };
 
+static const struct seq_operations extfrag_op = {
+	.start	= frag_start,
+	.next	= frag_next,
+	.stop	= frag_stop,
+	.show	= extfrag_show,
+};
+
+static int extfrag_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &extfrag_op);
+}
+
+static const struct file_operations extfrag_file_ops = {
+	.open		= extfrag_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
 static const struct seq_operations pagetypeinfo_op = {
 	.start	= frag_start,
 	.next	= frag_next,
@@ -663,6 +738,10 @@ static const char * const vmstat_text[] = {
 	"nr_bounce",
 	"nr_vmscan_write",
 	"nr_writeback_temp",
+#ifdef CONFIG_CCACHE
+	"nr_ccache_pages",
+	"nr_ccache_pool",
+#endif
 
 #ifdef CONFIG_NUMA
 	"numa_hit",
@@ -715,6 +794,22 @@ static const char * const vmstat_text[] = {
 	"unevictable_pgs_stranded",
 	"unevictable_pgs_mlockfreed",
 #endif
+#ifdef CONFIG_CCACHE
+	"ccache_store",
+	"ccache_reject",
+	"ccache_hit",
+	"ccache_invalidate",
+	"ccache_evict",
+#endif
+#ifdef CONFIG_WORKINGSET
+	"workingset_refault",
+	"workingset_activate",
+#endif
+#ifdef CONFIG_COMPACTION
+	"compact_blocks_moved",
+	"compact_pages_moved",
+	"compact_pagemigrate_failed",
+#endif
 #endif
 };
 
@@ -961,6 +1056,7 @@ static int __init setup_vmstat(void)
 #ifdef CONFIG_PROC_FS
 	proc_create("buddyinfo", S_IRUGO, NULL, &fragmentation_file_operations);
 	proc_create("pagetypeinfo", S_IRUGO, NULL, &pagetypeinfo_file_ops);
+	proc_create("extfrag_index", S_IRUGO, NULL, &extfrag_file_ops);
 	proc_create("vmstat", S_IRUGO, NULL, &proc_vmstat_file_operations);
 	proc_create("zoneinfo", S_IRUGO, NULL, &proc_zoneinfo_file_operations);
 #endif
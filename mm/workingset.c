@@ -0,0 +1,160 @@
+/*
+ *	linux/mm/workingset.c
+ *
+ * Working set detection for the page cache.
+ *
+ * A page faulted into the page cache starts out on the inactive file list
+ * and is only activated on its second reference.  A single streaming read
+ * of more data than the inactive list holds therefore pushes out the file
+ * pages a foreground application keeps coming back to, before they are
+ * referenced a second time, however hot they are.
+ *
+ * Each zone counts the pages leaving its inactive file list, by eviction
+ * or by activation, in inactive_age.  When reclaim evicts a file page,
+ * the counter is stored in a shadow entry at the page's index in the
+ * shadow_tree of its mapping.  When the page is added to the page cache
+ * again, the difference to the current counter is its refault distance:
+ * how many more pages the inactive list would have needed to hold for the
+ * page to still be resident.  If that is no more than the size of the
+ * active file list, the page would have stayed in memory had the active
+ * list given up that many pages, so it is activated right away and
+ * competes with the active pages.  Pages of a stream never refault within
+ * that distance, so the active list grows only at the expense of pages
+ * which are not being used again.
+ *
+ * Shadow entries are protected by the mapping's tree_lock.  A mapping
+ * keeps at most as many as there are file pages on the LRU lists, as an
+ * older shadow entry could not lead to an activation anyway.  Truncation
+ * and the inode going away drop them.
+ *
+ * This file is released under the GPL v2.
+ */
+
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/sched.h>
+#include <linux/radix-tree.h>
+#include <linux/spinlock.h>
+#include <linux/vmstat.h>
+#include <linux/workingset.h>
+
+/*
+ * A shadow entry holds the eviction counter, node and zone of the page.
+ * The low bits keep it from looking like a NULL or indirect pointer to
+ * the radix tree.
+ */
+#define SHADOW_TAG		2UL
+#define SHADOW_TAG_SHIFT	2
+#define EVICTION_SHIFT		(SHADOW_TAG_SHIFT + NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_MASK		(~0UL >> EVICTION_SHIFT)
+
+static void *pack_shadow(struct zone *zone, unsigned long eviction)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << SHADOW_TAG_SHIFT) | SHADOW_TAG;
+	return (void *)eviction;
+}
+
+static struct zone *unpack_shadow(void *shadow, unsigned long *eviction)
+{
+	unsigned long entry = (unsigned long)shadow >> SHADOW_TAG_SHIFT;
+	int zid, nid;
+
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	*eviction = entry;
+	return NODE_DATA(nid)->node_zones + zid;
+}
+
+/**
+ * workingset_eviction - leave a shadow entry for a page being reclaimed
+ * @mapping: the address_space @page is in
+ * @page: the locked, clean page about to be removed from the page cache
+ *
+ * Called under the mapping's tree_lock, just before @page is removed.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+
+	if (mapping->nrshadows >= global_page_state(NR_ACTIVE_FILE) +
+				  global_page_state(NR_INACTIVE_FILE))
+		return;
+	if (!radix_tree_insert(&mapping->shadow_tree, page->index,
+			       pack_shadow(zone, eviction)))
+		mapping->nrshadows++;
+}
+
+void *__workingset_take_shadow(struct address_space *mapping, pgoff_t index)
+{
+	void *shadow;
+
+	shadow = radix_tree_delete(&mapping->shadow_tree, index);
+	if (shadow)
+		mapping->nrshadows--;
+	return shadow;
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: the shadow entry of the page when it was evicted
+ *
+ * Returns 1 if the page should be added to the active list.
+ */
+int workingset_refault(void *shadow)
+{
+	unsigned long eviction, distance;
+	struct zone *zone;
+
+	zone = unpack_shadow(shadow, &eviction);
+	distance = (atomic_long_read(&zone->inactive_age) - eviction) &
+		   EVICTION_MASK;
+
+	count_vm_event(WORKINGSET_REFAULT);
+	if (distance > zone_page_state(zone, NR_ACTIVE_FILE))
+		return 0;
+	count_vm_event(WORKINGSET_ACTIVATE);
+	return 1;
+}
+
+/**
+ * workingset_activation - note a page leaving the inactive file list
+ * @page: the page being moved to the active list
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+void __workingset_invalidate_range(struct address_space *mapping,
+				   pgoff_t start, pgoff_t end)
+{
+	unsigned long indices[16];
+	void **slots[16];
+	unsigned int i, nr;
+
+	while (start <= end) {
+		spin_lock_irq(&mapping->tree_lock);
+		nr = radix_tree_gang_lookup_slot(&mapping->shadow_tree, slots,
+						 indices, start,
+						 ARRAY_SIZE(slots));
+		for (i = 0; i < nr && indices[i] <= end; i++) {
+			radix_tree_delete(&mapping->shadow_tree, indices[i]);
+			mapping->nrshadows--;
+		}
+		spin_unlock_irq(&mapping->tree_lock);
+
+		if (i < ARRAY_SIZE(slots))
+			break;
+		start = indices[i - 1] + 1;
+		if (!start)	/* wrapped */
+			break;
+		cond_resched();
+	}
+}
@@ -54,6 +54,8 @@
 #include <linux/cache.h>
 #include <linux/rtnetlink.h>
 #include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/notifier.h>
 #include <linux/scatterlist.h>
 
 #include <net/protocol.h>
@@ -143,6 +145,76 @@ void skb_under_panic(struct sk_buff *skb, int sz, void *here)
 	BUG();
 }
 
+/*
+ * A small per-cpu stash of heads in front of skbuff_head_cache.  Heads
+ * freed by kfree_skbmem() are parked here and handed back to the slab
+ * half a stash at a time; atomic allocations, which come in bursts from
+ * the receive path, refill it the same way.
+ */
+#define SKB_HEAD_STASH		32
+#define SKB_HEAD_STASH_BATCH	(SKB_HEAD_STASH / 2)
+
+struct skb_head_stash {
+	unsigned int	count;
+	void		*heads[SKB_HEAD_STASH];
+};
+
+static DEFINE_PER_CPU(struct skb_head_stash, skb_head_stash);
+
+static struct sk_buff *skb_head_get(gfp_t gfp_mask)
+{
+	struct skb_head_stash *hs;
+	struct sk_buff *skb = NULL;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	hs = &__get_cpu_var(skb_head_stash);
+	if (!hs->count && !(gfp_mask & __GFP_WAIT))
+		hs->count = kmem_cache_alloc_bulk(skbuff_head_cache,
+						  gfp_mask & ~__GFP_ZERO,
+						  SKB_HEAD_STASH_BATCH,
+						  hs->heads);
+	if (hs->count)
+		skb = hs->heads[--hs->count];
+	local_irq_restore(flags);
+
+	if (!skb)
+		return kmem_cache_alloc(skbuff_head_cache, gfp_mask);
+	if (unlikely(gfp_mask & __GFP_ZERO))
+		memset(skb, 0, sizeof(*skb));
+	return skb;
+}
+
+static void skb_head_put(struct sk_buff *skb)
+{
+	struct skb_head_stash *hs;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	hs = &__get_cpu_var(skb_head_stash);
+	if (hs->count == SKB_HEAD_STASH) {
+		hs->count -= SKB_HEAD_STASH_BATCH;
+		kmem_cache_free_bulk(skbuff_head_cache, SKB_HEAD_STASH_BATCH,
+				     hs->heads + hs->count);
+	}
+	hs->heads[hs->count++] = skb;
+	local_irq_restore(flags);
+}
+
+static int __cpuinit skb_head_stash_callback(struct notifier_block *nfb,
+					     unsigned long action, void *hcpu)
+{
+	struct skb_head_stash *hs;
+
+	if (action != CPU_DEAD && action != CPU_DEAD_FROZEN)
+		return NOTIFY_OK;
+
+	hs = &per_cpu(skb_head_stash, (unsigned long)hcpu);
+	kmem_cache_free_bulk(skbuff_head_cache, hs->count, hs->heads);
+	hs->count = 0;
+	return NOTIFY_OK;
+}
+
 /* 	Allocate a new skbuff. We do this ourselves so we can fill in a few
  *	'private' fields and also do memory statistics to find all the
  *	[BEEP] leaks.
@@ -175,7 +247,10 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 	cache = fclone ? skbuff_fclone_cache : skbuff_head_cache;
 
 	/* Get the HEAD */
-	skb = kmem_cache_alloc_node(cache, gfp_mask & ~__GFP_DMA, node);
+	if (!fclone && node < 0)
+		skb = skb_head_get(gfp_mask & ~__GFP_DMA);
+	else
+		skb = kmem_cache_alloc_node(cache, gfp_mask & ~__GFP_DMA, node);
 	if (!skb)
 		goto out;
 
@@ -219,7 +294,10 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 out:
 	return skb;
 nodata:
-	kmem_cache_free(cache, skb);
+	if (!fclone)
+		skb_head_put(skb);
+	else
+		kmem_cache_free(cache, skb);
 	skb = NULL;
 	goto out;
 }
@@ -347,7 +425,7 @@ static void kfree_skbmem(struct sk_buff *skb)
 
 	switch (skb->fclone) {
 	case SKB_FCLONE_UNAVAILABLE:
-		kmem_cache_free(skbuff_head_cache, skb);
+		skb_head_put(skb);
 		break;
 
 	case SKB_FCLONE_ORIG:
@@ -597,7 +675,7 @@ struct sk_buff *skb_clone(struct sk_buff *skb, gfp_t gfp_mask)
 		n->fclone = SKB_FCLONE_CLONE;
 		atomic_inc(fclone_ref);
 	} else {
-		n = kmem_cache_alloc(skbuff_head_cache, gfp_mask);
+		n = skb_head_get(gfp_mask);
 		if (!n)
 			return NULL;
 		n->fclone = SKB_FCLONE_UNAVAILABLE;
@@ -2664,6 +2742,7 @@ void __init skb_init(void)
 						0,
 						SLAB_HWCACHE_ALIGN|SLAB_PANIC,
 						NULL);
+	hotcpu_notifier(skb_head_stash_callback, 0);
 }
 
 /**